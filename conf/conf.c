@@ -116,6 +116,8 @@ config_alloc(const char *name)
   scheduled_contact_entries * sces = lp_allocz(l, sizeof(struct scheduled_contact_entries));
   sces->number_of_entries = 0;
   c->sces = sces;
+  c->sce_retention = SCE_RETENTION_DEFAULT;
+  c->sce_lookahead = SCE_LOOKAHEAD_DEFAULT;
 
   return c;
 }
@@ -65,6 +65,10 @@ struct config {
 
   // EXTENSION to define scheduled contact entries
   struct scheduled_contact_entries * sces;
+  uint sces_max;			/* Allocated size of sces->entries */
+  const char *sce_file;			/* Contact plan file, see sce_store_load_file() */
+  btime sce_retention;			/* How long ended contacts are kept */
+  btime sce_lookahead;			/* How long before a contact its routes are prepared */
 };
 
 /* Please don't use these variables in protocols. Use proto_config->global instead. */
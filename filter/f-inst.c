@@ -818,6 +818,29 @@
     (*fs->rte)->pref = v1.val.i;
   }
 
+  INST(FI_SCE_ROUTE, 0, 1) {	/* Route built over a scheduled contact */
+    ACCESS_RTE;
+    ACCESS_EATTRS;
+    RESULT(T_BOOL, i, [[ !!ea_find(*fs->eattrs, EA_GEN_SCE) ]]);
+  }
+
+  INST(FI_SCE_REMAINING, 0, 1) {	/* Remaining window of the contact in ms */
+    ACCESS_RTE;
+    ACCESS_EATTRS;
+    RESULT(T_INT, i, [[ sce_ea_remaining(ea_find(*fs->eattrs, EA_GEN_SCE)) ]]);
+  }
+
+  INST(FI_SCE_PAIR, 0, 1) {	/* AS pair of the contact */
+    ACCESS_RTE;
+    ACCESS_EATTRS;
+    u64 end;
+    u32 asn_lo, asn_hi;
+    const struct adata *pair = &null_adata;
+    if (sce_ea_get(ea_find(*fs->eattrs, EA_GEN_SCE), &end, &asn_lo, &asn_hi))
+      pair = as_path_prepend(fpool, as_path_prepend(fpool, &null_adata, asn_hi), asn_lo);
+    RESULT(T_PATH, ad, pair);
+  }
+
   INST(FI_LENGTH, 1, 1) {	/* Get length of */
     ARG_ANY(1);
     switch(v1.type) {
@@ -426,6 +426,29 @@ as_path_getlen(const struct adata *path)
   return res;
 }
 
+/*
+ * Returns the next ASN of the path in @as, or 0 at its end. Empty segments are
+ * skipped, the type of the segment of the ASN is left in @it->type.
+ */
+int
+as_path_iter_next(struct as_path_iter *it, u32 *as)
+{
+  while (!it->left)
+  {
+    if (it->pos >= it->end)
+      return 0;
+
+    it->type = it->pos[0];
+    it->left = it->pos[1];
+    it->pos += 2;
+  }
+
+  *as = get_as(it->pos);
+  it->pos += BS;
+  it->left--;
+  return 1;
+}
+
 int
 as_path_get_last(const struct adata *path, u32 *orig_as)
 {
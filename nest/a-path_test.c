@@ -102,6 +102,44 @@ t_path_format(void)
   return 1;
 }
 
+static int
+t_path_iter(void)
+{
+  /* 1 2 {} {7 8} 9 */
+  byte data[] = {
+    AS_PATH_SEQUENCE, 2, 0, 0, 0, 1, 0, 0, 0, 2,
+    AS_PATH_SEQUENCE, 0,
+    AS_PATH_SET, 2, 0, 0, 0, 7, 0, 0, 0, 8,
+    AS_PATH_SEQUENCE, 1, 0, 0, 0, 9,
+  };
+  struct adata *path = alloca(sizeof(struct adata) + sizeof(data));
+  path->length = sizeof(data);
+  memcpy(path->data, data, sizeof(data));
+
+  const u32 asns[] = { 1, 2, 7, 8, 9 };
+  const int sets[] = { 0, 0, 1, 1, 0 };
+
+  struct as_path_iter it;
+  as_path_iter_init(&it, path);
+
+  u32 asn;
+  for (uint i = 0; i < ARRAY_SIZE(asns); i++)
+  {
+    bt_assert(as_path_iter_next(&it, &asn));
+    bt_assert_msg(asn == asns[i], "ASN %u, expected %u", asn, asns[i]);
+    bt_assert(as_path_iter_in_set(&it) == sets[i]);
+  }
+
+  bt_assert(!as_path_iter_next(&it, &asn));
+  bt_assert(!as_path_iter_next(&it, &asn));
+
+  struct adata empty_as_path = {};
+  as_path_iter_init(&it, &empty_as_path);
+  bt_assert(!as_path_iter_next(&it, &asn));
+
+  return 1;
+}
+
 static int
 count_asn_in_array(const u32 *array, u32 asn)
 {
@@ -212,6 +250,7 @@ main(int argc, char *argv[])
   bt_test_suite(t_as_path_match, "Testing AS path matching and some a-path utilities.");
   bt_test_suite(t_path_format, "Testing formating as path into byte buffer");
   bt_test_suite(t_path_include, "Testing including a AS number in AS path");
+  bt_test_suite(t_path_iter, "Testing walking the ASNs of AS path in place");
   // bt_test_suite(t_as_path_converting, "Testing as_path_convert_to_*() output constancy");
 
   return bt_exit_value();
@@ -54,6 +54,21 @@ const struct adata *as_path_filter(struct linpool *pool, const struct adata *pat
 static inline struct adata *as_path_prepend(struct linpool *pool, const struct adata *path, u32 as)
 { return as_path_prepend2(pool, path, AS_PATH_SEQUENCE, as); }
 
+/* Read-only walk over the ASNs of a path, the data is not copied */
+struct as_path_iter {
+  const byte *pos, *end;
+  uint type;				/* Segment type of the last returned ASN */
+  uint left;				/* ASNs left in the current segment */
+};
+
+static inline void as_path_iter_init(struct as_path_iter *it, const struct adata *path)
+{ *it = (struct as_path_iter) { .pos = path->data, .end = path->data + path->length }; }
+
+static inline int as_path_iter_in_set(const struct as_path_iter *it)
+{ return (it->type == AS_PATH_SET) || (it->type == AS_PATH_CONFED_SET); }
+
+int as_path_iter_next(struct as_path_iter *it, u32 *as);
+
 
 #define PM_ASN		0
 #define PM_QUESTION	1
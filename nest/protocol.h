@@ -411,6 +411,7 @@ void proto_notify_state(struct proto *p, unsigned state);
 
 #define MD_STATES	1		/* Protocol state changes (BGP4MP_MESSAGE_AS4) */
 #define MD_MESSAGES	2		/* Protocol packets (BGP4MP_MESSAGE_AS4) */
+#define MD_CONTACTS	4		/* Scheduled contacts and their routes (MRT_SCE) */
 
 /*
  *	Known unique protocol instances as referenced by config routines
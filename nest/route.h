@@ -187,6 +187,9 @@ typedef struct rtable {
 
   list subscribers;			/* Subscribers for notifications */
   struct timer *settle_timer;		/* Settle time for notifications */
+
+  // Extension: index of AS pairs in AS paths, created by the SCE extension on demand
+  struct sce_index *sce_index;
 } rtable;
 
 struct rt_subscription {
@@ -286,6 +289,7 @@ typedef struct rte {
 #define REF_STALE	4		/* Route is stale in a refresh cycle */
 #define REF_DISCARD	8		/* Route is scheduled for discard */
 #define REF_MODIFY	16		/* Route is scheduled for modify */
+#define REF_LOCAL	32		/* Route is locally derived, not sent to BGP peers (Extension) */
 
 /* Route is valid for propagation (may depend on other flags in the future), accepts NULL */
 static inline int rte_is_valid(rte *r) { return r && !(r->flags & REF_FILTERED); }
@@ -293,6 +297,9 @@ static inline int rte_is_valid(rte *r) { return r && !(r->flags & REF_FILTERED);
 /* Route just has REF_FILTERED flag */
 static inline int rte_is_filtered(rte *r) { return !!(r->flags & REF_FILTERED); }
 
+/* Route was derived from other routes of its source, it does not replace them */
+static inline int rte_is_local(rte *r) { return !!(r->flags & REF_LOCAL); }
+
 
 /* Types of route announcement, also used as flags */
 #define RA_UNDEF	0		/* Undefined RA type */
@@ -329,6 +336,10 @@ int net_roa_check(rtable *tab, const net_addr *n, u32 asn);
 rte *rte_find(net *net, struct rte_src *src);
 rte *rte_get_temp(struct rta *);
 void rte_update2(struct channel *c, const net_addr *n, rte *new, struct rte_src *src);
+// Extension: batch of route updates of contact events
+void rte_update_batch_lock(void);
+void rte_update_batch_unlock(void);
+void rte_remove_local(rte *old);
 /* rte_update() moved to protocol.h to avoid dependency conflicts */
 int rt_examine(rtable *t, net_addr *a, struct proto *p, const struct filter *filter);
 rte *rt_export_merged(struct channel *c, net *net, rte **rt_free, linpool *pool, int silent);
@@ -525,6 +536,7 @@ typedef struct eattr {
 const char *ea_custom_name(uint ea);
 
 #define EA_GEN_IGP_METRIC EA_CODE(PROTOCOL_NONE, 0)
+#define EA_GEN_SCE EA_CODE(PROTOCOL_NONE, 1)	/* Scheduled contact of the route, see sce_ea_get() */
 
 #define EA_CODE_MASK 0xffff
 #define EA_CUSTOM_BIT 0x8000
@@ -55,6 +55,7 @@
 #include "lib/idm.h"
 #include "lib/resource.h"
 #include "lib/string.h"
+#include "proto/bgp/sce_extension.h"
 
 #include <stddef.h>
 
@@ -803,6 +804,18 @@ get_generic_attr(const eattr *a, byte **buf, int buflen UNUSED)
       return GA_NAME;
     }
 
+  u64 end;
+  u32 asn_lo, asn_hi;
+  if ((a->id == EA_GEN_SCE) && sce_ea_get(a, &end, &asn_lo, &asn_hi))
+    {
+      byte tbuf[TM_DATETIME_BUFFER_SIZE];
+      if (!tm_format_real_time(tbuf, sizeof(tbuf), "%F %T", (btime) (end + DTNEPOCH) MS_))
+	strcpy(tbuf, "<error>");
+
+      *buf += bsprintf(*buf, "sce_contact: %u %u until %s", asn_lo, asn_hi, tbuf);
+      return GA_FULL;
+    }
+
   return GA_UNKNOWN;
 }
 
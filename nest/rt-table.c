@@ -1079,8 +1079,22 @@ rte_same(rte *x, rte *y)
 
 static inline int rte_is_ok(rte *e) { return e && !rte_is_filtered(e); }
 
+/*
+ * Extension: a locally derived route (REF_LOCAL) is added next to the routes of
+ * its source and never replaces them. It is only removed or replaced by its own
+ * pointer @local, see rte_remove_local().
+ */
+static inline int
+rte_replaces(rte *old, rte *new, struct rte_src *src, rte *local)
+{
+  if (local || rte_is_local(old) || (new && rte_is_local(new)))
+    return old == local;
+
+  return old->attrs->src == src;
+}
+
 static void
-rte_recalculate(struct channel *c, net *net, rte *new, struct rte_src *src)
+rte_recalculate(struct channel *c, net *net, rte *new, struct rte_src *src, rte *local)
 {
   struct proto *p = c->proto;
   struct rtable *table = c->table;
@@ -1092,59 +1106,9 @@ rte_recalculate(struct channel *c, net *net, rte *new, struct rte_src *src)
   rte **k;
   k = &net->routes;			/* Find and remove original route from the same protocol */
 
-  // Extension
-  // do we want to delete a route because a scheduled contact ended?
-  _Bool sce_withdraw = 0;
-  /*
-   * If a route needs to be deleted, the rte new pflags are 0x77.
-   * Therefore we delete and relink routes here.
-   * After that we jump to do_recalculate to have the best route at
-   * the first position of net->routes.
-   * After that the route change is advertised.
-   */
-  if (new) if (new->pflags == 0x77) {
-
-	  sce_withdraw = 1;
-
-	  // saves the old accessed route to relink
-	  rte * old_rt = net->routes;
-	  // index to identify if it is the first route that has to be deleted
-	  int rt_index = 0;
-	  for (rte * cur_rt = net->routes ; cur_rt ; cur_rt = cur_rt->next) {
-		  if (cur_rt == new) {
-
-			  // the first (best) route is deleted
-			  if (rt_index == 0) {
-				  *k = cur_rt->next;
-				  table->rt_count--;
-				  rte_free_quick(new);
-				  new = NULL;
-
-				  // we go to do_recalculate, to find a new best route
-				  goto do_recalculate;
-				  break;
-			  }
-
-			  // an intermediate route is deleted
-			  // the routes must be relinked properly
-			  old_rt->next = cur_rt->next;
-			  table->rt_count--;
-			  rte_free_quick(new);
-			  new = NULL;
-
-			  // we go to after_recalculate, because we do not need a new best route
-			  goto after_recalculate;
-
-			  break;
-		  }
-		  old_rt = cur_rt;
-		  rt_index++;
-	  }
-  }
-
   while (old = *k)
     {
-      if (old->attrs->src == src)
+      if (rte_replaces(old, new, src, local))
 	{
 	  /* If there is the same route in the routing table but from
 	   * a different sender, then there are two paths from the
@@ -1182,9 +1146,6 @@ rte_recalculate(struct channel *c, net *net, rte *new, struct rte_src *src)
 	      return;
 	    }
 
-	  // Extension: we do not want to delete routes when a new route is learned via a sce
-	  if (new) if (new->pflags == 0x99) break;
-
 	  *k = old->next;
 	  table->rt_count--;
 	  break;
@@ -1364,9 +1325,6 @@ rte_recalculate(struct channel *c, net *net, rte *new, struct rte_src *src)
       /* The fourth (empty) case - suboptimal route was removed, nothing to do */
     }
 
-  // Extension: new label
-  after_recalculate:
-
   if (new)
     {
       new->lastmod = current_time();
@@ -1397,61 +1355,19 @@ rte_recalculate(struct channel *c, net *net, rte *new, struct rte_src *src)
     }
 
   /* Propagate the route change */
-
-  /*
-   * Extension:
-   * We set "markers" (->pflags = 0x55) to the routes, that are given to rte_announce
-   * to catch this announcement in attrs.c: after_recalculate(), to prevent
-   * that a route withdraw is announced.
-   * The original pflags value is later assigned again.
-   * This is done because we do not want UPDATES that originated from the extension.
-   */
-  int net_rt;
-  int new_rt;
-  int old_rt;
-  int old_best_rt;
-
-  if (sce_withdraw) {
-	  if (net) if (net->routes) {
-		  net_rt = net->routes->pflags;
-		  net->routes->pflags = 0x55;
-	  }
-	  if (new) {
-		  new_rt = new->pflags;
-		  new->pflags = 0x55;
-	  }
-	  if (old) {
-		  old_rt = old->pflags;
-		  old->pflags = 0x55;
-	  }
-	  if (old_best) {
-		  old_best_rt = old_best->pflags;
-		  old_best->pflags = 0x55;
-	  }
-  }
-
   rte_announce(table, RA_UNDEF, net, new, old, net->routes, old_best);
 
-  if (sce_withdraw) {
-	  if (net) if (net->routes) {
-		  net->routes->pflags = net_rt;
-	  }
-	  if (new) {
-		  new->pflags = new_rt;
-	  }
-	  if (old) {
-		  old->pflags = old_rt;
-	  }
-	  if (old_best) {
-		  old_best->pflags = old_best_rt;
-	  }
-  }
-
   if (!net->routes &&
       (table->gc_counter++ >= table->config->gc_max_ops) &&
       (table->gc_time + table->config->gc_min_time <= current_time()))
     rt_schedule_prune(table);
 
+#ifdef CONFIG_BGP
+  // Extension: keep the AS pair index up to date
+  if (table->sce_index)
+    sce_index_update(table->sce_index, net, new, old);
+#endif
+
   if (old_ok && p->rte_remove)
     p->rte_remove(net, old);
   if (new_ok && p->rte_insert)
@@ -1462,9 +1378,6 @@ rte_recalculate(struct channel *c, net *net, rte *new, struct rte_src *src)
       if (!new)
 	hmap_clear(&table->id_map, old->id);
 
-      // we do not want to delete routes when a new route is learned via a sce
-      if (new) if (new->pflags == 0x99) return;
-
       rte_free_quick(old);
     }
 }
@@ -1484,6 +1397,19 @@ rte_update_unlock(void)
     lp_flush(rte_update_pool);
 }
 
+// Extension: route updates of contact events, that fire at the same time, share one lock window
+void
+rte_update_batch_lock(void)
+{
+  rte_update_lock();
+}
+
+void
+rte_update_batch_unlock(void)
+{
+  rte_update_unlock();
+}
+
 static inline void
 rte_hide_dummy_routes(net *net, rte **dummy)
 {
@@ -1632,7 +1558,7 @@ rte_update2(struct channel *c, const net_addr *n, rte *new, struct rte_src *src)
  recalc:
   /* And recalculate the best route */
   rte_hide_dummy_routes(nn, &dummy);
-  rte_recalculate(c, nn, new, src);
+  rte_recalculate(c, nn, new, src, NULL);
   rte_unhide_dummy_routes(nn, &dummy);
 
   rte_update_unlock();
@@ -1647,6 +1573,28 @@ rte_update2(struct channel *c, const net_addr *n, rte *new, struct rte_src *src)
   rte_update_unlock();
 }
 
+/**
+ * rte_remove_local - remove a locally derived route
+ * @old: route linked in its table, usually one with %REF_LOCAL flag
+ *
+ * This function removes the route @old from its network and recalculates the
+ * best route. Unlike a withdraw through rte_update2(), the route is given
+ * directly, so it works for locally derived routes, which share the source
+ * with the route they were derived from. (Extension)
+ */
+void
+rte_remove_local(rte *old)
+{
+  net *nn = old->net;
+  rte *dummy = NULL;
+
+  rte_update_lock();
+  rte_hide_dummy_routes(nn, &dummy);
+  rte_recalculate(old->sender, nn, NULL, old->attrs->src, old);
+  rte_unhide_dummy_routes(nn, &dummy);
+  rte_update_unlock();
+}
+
 /* Independent call to rte_announce(), used from next hop
    recalculation, outside of rte_update(). new must be non-NULL */
 static inline void
@@ -1662,7 +1610,7 @@ static inline void
 rte_discard(rte *old)	/* Non-filtered route deletion, used during garbage collection */
 {
   rte_update_lock();
-  rte_recalculate(old->sender, old->net, NULL, old->attrs->src);
+  rte_recalculate(old->sender, old->net, NULL, old->attrs->src, rte_is_local(old) ? old : NULL);
   rte_update_unlock();
 }
 
@@ -1682,7 +1630,7 @@ rte_modify(rte *old)
       new->flags = (old->flags & ~REF_MODIFY) | REF_COW;
     }
 
-    rte_recalculate(old->sender, old->net, new, old->attrs->src);
+    rte_recalculate(old->sender, old->net, new, old->attrs->src, rte_is_local(old) ? old : NULL);
   }
 
   rte_update_unlock();
@@ -1731,6 +1679,9 @@ rt_examine(rtable *t, net_addr *a, struct proto *p, const struct filter *filter)
  * implemented by marking all related routes as stale by REF_STALE flag in
  * rt_refresh_begin(), then marking all related stale routes with REF_DISCARD
  * flag in rt_refresh_end() and then removing such routes in the prune loop.
+ *
+ * Extension: locally derived routes (REF_LOCAL) are never sent by the peer,
+ * so they are not marked stale. They are removed through rte_remove_local().
  */
 void
 rt_refresh_begin(rtable *t, struct channel *c)
@@ -1739,7 +1690,7 @@ rt_refresh_begin(rtable *t, struct channel *c)
     {
       rte *e;
       for (e = n->routes; e; e = e->next)
-	if (e->sender == c)
+	if ((e->sender == c) && !rte_is_local(e))
 	  e->flags |= REF_STALE;
     }
   FIB_WALK_END;
@@ -1783,7 +1734,7 @@ rt_modify_stale(rtable *t, struct channel *c)
     {
       rte *e;
       for (e = n->routes; e; e = e->next)
-	if ((e->sender == c) && (e->flags & REF_STALE) && !(e->flags & REF_FILTERED))
+	if ((e->sender == c) && (e->flags & REF_STALE) && !(e->flags & REF_FILTERED) && !rte_is_local(e))
 	  {
 	    e->flags |= REF_MODIFY;
 	    prune = 1;
@@ -966,29 +966,30 @@ bgp_format_mpls_label_stack(const eattr *a, byte *buf, uint size)
 
 /**
  * Extension
- * Load the scheduled contact entries and add them to @buf.
+ * Add the CBOR encoding of the scheduled contact entries, that the peer did not get yet,
+ * to @buf. A plan, that does not fit, is sent in parts over the following UPDATEs.
+ * The fake write state of the MRT table dump has no channel, it gets the whole plan.
  */
 static int
 bgp_encode_scheduled(struct bgp_write_state *s, eattr *a, byte *buf, uint size)
 {
 	unsigned int data_size = 0;
-	unsigned char * cbor_sces = get_sces_cbor(&data_size);
+	unsigned char * cbor_sces;
 
-	if (cbor_sces == NULL) return 0;
-	if (data_size == 0) return 0;
+	// at most the rest of the UPDATE and the length of an attribute with extended length
+	if (size <= 4) return 0;
+	uint max = MIN(size - 4, 0xffff);
 
-	int len;
-
-	if (data_size < 256)
-		len = bgp_put_attr_hdr3(buf, BA_SCHEDULED, a->flags, data_size);
-	else
-		len = bgp_put_attr_hdr4(buf, BA_SCHEDULED, a->flags, data_size);
-
-	memcpy(buf+len, cbor_sces, data_size);
-
-	len += data_size;
+	if (!s->channel) {
+		cbor_sces = get_sces_cbor(&data_size);
+		if (!cbor_sces || (data_size > max)) return 0;
+	}
+	else {
+		cbor_sces = get_sces_cbor_since(s->channel->sce_sent, max, s->pool, &data_size, &s->sce_version);
+		if (!cbor_sces) return 0;
+	}
 
-	return len;
+	return bgp_put_attr(buf, size, BA_SCHEDULED, a->flags, cbor_sces, data_size);
 }
 
 /**
@@ -996,69 +997,10 @@ bgp_encode_scheduled(struct bgp_write_state *s, eattr *a, byte *buf, uint size)
  * Decode scheduled contact entries and hand them over to sce_extension.c.
  */
 static void
-bgp_decode_scheduled(struct bgp_parse_state *s, uint code, uint flags, byte *data, uint len, ea_list **to)
+bgp_decode_scheduled(struct bgp_parse_state *s, uint code UNUSED, uint flags UNUSED, byte *data, uint len, ea_list **to UNUSED)
 {
-	unsigned int offset = 0;
-	struct cbor_token token;
-
-	scheduled_contact_entries * entries = malloc(sizeof(scheduled_contact_entries));
-
-	offset = cbor_read_token(data, len, offset, &token);
-
-	u16 num_of_e = token.int_value;
-	scheduled_contact_entry * new_entries = malloc(sizeof(scheduled_contact_entry) * num_of_e);
-
-	entries->number_of_entries = num_of_e;
-	entries->entries = new_entries;
-
-	unsigned char entries_num = 0;
-	unsigned char val_index = 0;
-
-	while(1) {
-
-		offset = cbor_read_token(data, len, offset, &token);
-
-        if(token.type == CBOR_TOKEN_TYPE_INCOMPLETE) {
-            break;
-        }
-        if(token.type == CBOR_TOKEN_TYPE_ERROR) {
-            break;
-        }
-
-		if(token.type == CBOR_TOKEN_TYPE_INT) {
-	        if (val_index == 0) (new_entries+entries_num)->start_time = token.int_value;
-	        if (val_index == 1) (new_entries+entries_num)->duration = token.int_value;
-	        if (val_index == 2) (new_entries+entries_num)->asn1 = token.int_value;
-	        if (val_index == 3) (new_entries+entries_num)->gw1 = token.int_value;
-	        if (val_index == 4) (new_entries+entries_num)->asn2 = token.int_value;
-	        if (val_index == 5) (new_entries+entries_num)->gw2 = token.int_value;
-
-	        if (val_index == 5) entries_num++;
-
-			val_index = (val_index + 1) % 6;
-			continue;
-	    }
-
-	    if(token.type == CBOR_TOKEN_TYPE_LONG) {
-	            if (val_index == 0) (new_entries+entries_num)->start_time = token.long_value;
-	            if (val_index == 1) (new_entries+entries_num)->duration = token.long_value;
-	            if (val_index == 2) (new_entries+entries_num)->asn1 = token.long_value;
-	            if (val_index == 3) (new_entries+entries_num)->gw1 = token.long_value;
-	            if (val_index == 4) (new_entries+entries_num)->asn2 = token.long_value;
-	            if (val_index == 5) (new_entries+entries_num)->gw2 = token.long_value;
-
-				if (val_index == 5) entries_num++;
-				val_index = (val_index + 1) % 6;
-				continue;
-	        }
-
-	        if(token.type == CBOR_TOKEN_TYPE_ARRAY) {
-	        	continue;
-	        }
-		}
-
 	// searches the IPv4 channel
-	struct bgp_channel * bgp_ch;
+	struct bgp_channel * bgp_ch = NULL;
 	uint i;
 	for (i = 0; i < s->proto->channel_count; i++) {
 	  if (s->proto->afi_map[i] == BGP_AF_IPV4) {
@@ -1067,7 +1009,12 @@ bgp_decode_scheduled(struct bgp_parse_state *s, uint code, uint flags, byte *dat
 	  }
 	}
 
-	store_sces(entries, &(bgp_ch->c), s->proto);
+	if (!bgp_ch)
+	  return;
+
+	// the sces are decoded straight into the resident plan
+	if (sce_store_decode(sce_store_get(), data, len, &(bgp_ch->c), s->proto) < 0)
+	  DISCARD("Malformed SCHEDULED attribute");
 }
 
 static inline void
@@ -1367,13 +1314,24 @@ bgp_encode_attrs(struct bgp_write_state *s, ea_list *attrs, byte *buf, byte *end
     pos += len;
   }
   // Extension
-  // add the scheduled contact entry attribute to the UPDATE message
-  eattr *myattr = malloc(sizeof(eattr));
-  myattr->id = 0x99; // id of scheduled attribute
-  myattr->flags = 0xd0; // --> 1101 optional & transitive & ext. length
-  myattr->type = 0x99;
-  len = bgp_encode_attr(s, myattr, pos, end - pos);
+  // add the scheduled contact entries, that the peer did not get yet, to the UPDATE message
+  eattr myattr = {
+    .id = BA_SCHEDULED,		// id of scheduled attribute
+    .flags = 0xd0,		// --> 1101 optional & transitive & ext. length
+    .type = EAF_TYPE_SCHEDULED,
+  };
+  s->sce_version = 0;
+  len = bgp_encode_attr(s, &myattr, pos, end - pos);
+
+  // the routes are sent anyway, the plan follows with the next UPDATE
+  if (len < 0)
+    return pos - buf;
+
   pos += len;
+
+  // the peer knows the plan up to this version now
+  if (s->channel && s->sce_version)
+    s->channel->sce_sent = s->sce_version;
   // end
   return pos - buf;
 }
@@ -1967,24 +1925,12 @@ bgp_rt_notify(struct proto *P, struct channel *C, net *n, rte *new, rte *old)
   struct bgp_prefix *px;
   u32 path;
 
-  /*
-   * Extension
-   * If we encounter the marker 0x55 in any route, this announcement
-   * originated from the extension because of a route deletion.
-   * Therefore we do not want that this results in an UPDATE, so we return.
-   */
-  //
-  if (new) if (new->pflags == 0x55)  return;
-  if (old) if (old->pflags == 0x55) return;
-  if (n) if (n->routes) if (n->routes->pflags == 0x55) return;
+  // Extension: routes derived from scheduled contacts are not announced to the peers
+  if (new && rte_is_local(new))
+    return;
 
   if (new)
   {
-
-	// If we encounter a route with pflags = 0x99, this is a new route learned by a scheduled contact entry.
-	// Therefore we return, because we do not want that this route is announced with an update.
-	if (new->pflags == 0x99) return;
-
     struct ea_list *attrs = bgp_update_attrs(p, c, new, new->attrs->eattrs, bgp_linpool2);
 
     /* If attributes are invalid, we fail back to withdraw */
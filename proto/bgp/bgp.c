@@ -696,6 +696,11 @@ bgp_conn_enter_established_state(struct bgp_conn *conn)
 
   bgp_conn_set_state(conn, BS_ESTABLISHED);
   proto_notify_state(&p->p, PS_UP);
+
+  /* Extension: without End-of-RIB, the routes of open contacts are built right away */
+  struct channel *C = sce_channel(&p->p);
+  if (C && !C->disabled && (((struct bgp_channel *) C)->load_state != BFS_LOADING))
+    sce_store_reopen(sce_store_get(), C);
 }
 
 static void
@@ -1529,6 +1534,11 @@ bgp_start(struct proto *P)
   if (p->cf->confederation && !p->is_interior)
     p->public_as = cf->confederation;
 
+  /* Extension: take the plan over again, if it was cancelled while the protocol was disabled */
+  struct channel *C = sce_channel(P);
+  if (C)
+    sce_store_restart(sce_store_get(), C, p);
+
   p->passive = cf->passive || bgp_is_dynamic(p);
 
   p->start_state = BSS_PREPARE;
@@ -1721,20 +1731,19 @@ bgp_init(struct proto_config *CF)
    * EXTENSION
    * Add scheduled contact entries to bgp_proto struct
    * scheduled_contact_entries are defined in the configuration file "birdconf"
+   * or in the plan file of the option "sce plan".
+   * The plan persisted before the restart is scheduled by the first instance.
    */
-  if (CF->global->sces) {
-	  scheduled_contact_entries * entries = CF->global->sces;
-
-	  // searches the IPv4 channel
-	  struct channel * ch;
-	  WALK_LIST(ch, P->channels)
-	  	  if ( strcmp(ch->name, "ipv4") == 0 ) break;
-
-	  if ( strcmp(ch->name, "ipv4") == 0 ) {
-		  store_sces(entries, ch, p);
-	  } else {
-		  log(L_INFO "bgc.c 1732: IPv4 channel not found.");
-	  }
+  struct channel * ch = sce_channel(P);
+
+  if (ch) {
+	  sce_store_restart(sce_store_get(), ch, p);
+	  store_sces(CF->global->sces, ch, p);
+
+	  if (CF->global->sce_file)
+		  sce_store_load_file(sce_store_get(), CF->global->sce_file, 0, ch, p);
+  } else if (CF->global->sces->number_of_entries || CF->global->sce_file) {
+	  log(L_INFO "%s: IPv4 channel not found, scheduled contacts are ignored", P->name);
   }
 
   return P;
@@ -1854,6 +1863,10 @@ bgp_channel_cleanup(struct channel *C)
   if (c->igp_table_ip6)
     rt_unlock_table(c->igp_table_ip6);
 
+  /* Extension: the channel is freed with the protocol, the contacts must not keep it */
+  if (C->proto->reconfiguring || C->proto->disabled)
+    sce_store_unbind(sce_store_get(), C);
+
   c->index = 0;
 
   /* Cleanup rest of bgp_channel starting at pool field */
@@ -2107,6 +2120,16 @@ bgp_reconfigure(struct proto *P, struct proto_config *CF)
   if (same)
     p->cf = new;
 
+  /* Extension: add the contacts, that are new in the configuration or in the plan file */
+  if (same && (C = sce_channel(P)))
+  {
+    if (CF->global->sces->number_of_entries)
+      store_sces(CF->global->sces, C, p);
+
+    if (CF->global->sce_file)
+      sce_store_load_file(sce_store_get(), CF->global->sce_file, 0, C, p);
+  }
+
   /* Reset name counter */
   p->dynamic_name_counter = 0;
 
@@ -370,6 +370,9 @@ struct bgp_channel {
 
   u8 feed_state;			/* Feed state (TX) for EoR, RR packets, see BFS_* */
   u8 load_state;			/* Load state (RX) for EoR, RR packets, see BFS_* */
+
+  // Extension
+  u32 sce_sent;				/* Version of the contact plan the neighbor got, 0 = nothing */
 };
 
 struct bgp_prefix {
@@ -414,6 +417,9 @@ struct bgp_write_state {
 
   eattr *mp_next_hop;
   const adata *mpls_labels;
+
+  // Extension
+  u32 sce_version;			/* Version of the contact plan encoded in the UPDATE */
 };
 
 struct bgp_parse_state {
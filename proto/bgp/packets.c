@@ -2399,8 +2399,14 @@ bgp_rx_end_mark(struct bgp_parse_state *s, u32 afi)
     DISCARD(BAD_AFI, BGP_AFI(afi), BGP_SAFI(afi));
 
   if (c->load_state == BFS_LOADING)
+  {
     c->load_state = BFS_NONE;
 
+    /* Extension: the routes of the peer are known, build the routes of open contacts */
+    if (&c->c == sce_channel(&p->p))
+      sce_store_reopen(sce_store_get(), &c->c);
+  }
+
   if (p->p.gr_recovery)
     channel_graceful_restart_unlock(&c->c);
 
@@ -2697,6 +2703,8 @@ bgp_rx_route_refresh(struct bgp_conn *conn, byte *pkt, uint len)
   case BGP_RR_REQUEST:
     BGP_TRACE(D_PACKETS, "Got ROUTE-REFRESH");
     channel_request_feeding(&c->c);
+    // Extension: the whole contact plan is sent again
+    c->sce_sent = 0;
     break;
 
   case BGP_RR_BEGIN:
@@ -22,19 +22,143 @@
 
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <time.h>
 
 #include "bgp.h"
 #include "lib/unaligned.h"
 #include "lib/timer.h"
+#include "lib/heap.h"
 #include "nest/protocol.h"
 #include "nest/route.h" // for rte_better
+#include "nest/attrs.h" // for as_path_iter
 #include "nest/iface.h" // for neighbor
+#include "nest/cli.h"
+#include "proto/mrt/mrt.h"
 #include <inttypes.h> // for printing u64
 
 
 
+/*
+ * Scratch memory of the path computations. Everything allocated while a contact
+ * begins or ends is taken from this linpool and released at once when the event
+ * is done, only the new routes survive in the route attribute cache.
+ * Every thread has its own scratch memory, see sce_scratch_init().
+ */
+_Thread_local static pool * sce_scratch_pool;
+_Thread_local static linpool * sce_lp;
+
+/**
+ * Sets the pool of the scratch memory of the calling thread.
+ * Threads other than the main one must call it before any path computation,
+ * as the pools of the main thread must not be touched by them.
+ *
+ * @p: the pool, only used by the calling thread
+ */
+void sce_scratch_init(pool * p) {
+	if (!sce_scratch_pool)
+		sce_scratch_pool = p;
+}
+
+static inline void * sce_alloc(uint size) {
+	if (!sce_lp)
+		sce_lp = lp_new_default(sce_scratch_pool ?: &root_pool);
+
+	return lp_alloc(sce_lp, size);
+}
+
+/*
+ * Candidate AS paths built from the scratch memory are interned, so identical
+ * paths of different prefixes share one adata and duplicates are found by
+ * a hash lookup instead of comparing all paths with each other.
+ */
+struct sce_path {
+	struct sce_path * next;
+	u32 hash;
+	u32 seen;			// stamp of the last remove_duplicates() that met this path
+	struct adata ad;
+};
+
+#define SCEAP_KEY(n)		n->hash, &n->ad
+#define SCEAP_NEXT(n)		n->next
+#define SCEAP_EQ(h1,d1,h2,d2)	h1 == h2 && adata_same(d1, d2)
+#define SCEAP_FN(h,d)		h
+
+#define SCEAP_REHASH		sce_path_rehash
+#define SCEAP_PARAMS		/8, *2, 2, 2, 6, 20
+
+HASH_DEFINE_REHASH_FN(SCEAP, struct sce_path)
+
+_Thread_local static HASH(struct sce_path) sce_paths;
+_Thread_local static u32 sce_paths_stamp;
+
+/**
+ * Hashes the raw data of an attribute like ea_hash() does.
+ */
+static inline u32 sce_path_hash(const struct adata * d) {
+	u64 h = 0xafcef24eda8b29 ^ mem_hash(d->data, d->length);
+	h *= 0x68576150f3d6847;
+
+	return (h >> 32) ^ (h & 0xffffffff);
+}
+
+/**
+ * Returns the interned copy of the AS path data @d, it stays valid until sce_scratch_flush().
+ *
+ * @d: the AS path data
+ */
+static struct sce_path * sce_path_intern(const struct adata * d) {
+	if (!sce_paths.data)
+		HASH_INIT(sce_paths, sce_scratch_pool ?: &root_pool, 6);
+
+	u32 h = sce_path_hash(d);
+	struct sce_path * n = HASH_FIND(sce_paths, SCEAP, h, d);
+
+	if (n)
+		return n;
+
+	n = sce_alloc(sizeof(struct sce_path) + d->length);
+	n->hash = h;
+	n->seen = 0;
+	memcpy(&n->ad, d, sizeof(struct adata) + d->length);
+	HASH_INSERT2(sce_paths, SCEAP, sce_scratch_pool ?: &root_pool, n);
+
+	return n;
+}
+
+/**
+ * Releases the scratch memory of the path computations.
+ */
+void sce_scratch_flush(void) {
+	if (sce_lp)
+		lp_flush(sce_lp);
+
+	// the interned paths were taken from the scratch memory
+	if (sce_paths.count)
+		HASH_FREE(sce_paths);
+}
+
+/**
+ * Wraps the AS path data @d into an AS_PATH eattr.
+ * Identical paths of other prefixes share the data.
+ *
+ * @d: the AS path data, allocated by sce_alloc()
+ */
+static eattr * sce_attr_new(adata * d) {
+	eattr * new_attr = sce_alloc(sizeof(eattr));
+
+	new_attr->id = 770;
+	new_attr->flags = 0x40;
+	new_attr->type = 6;
+	new_attr->u.ptr = &sce_path_intern(d)->ad;
+
+	return new_attr;
+}
+
 /**
  * Builds the AS_PATH attribute as eattr
  * @as_path: path of ASN
@@ -43,28 +167,79 @@
 eattr * build_attr(u32 * as_path, u8 sizeofpath) {
 
 	// the path does not contain the own ASN
-	as_path = kick_first_segment(as_path, --sizeofpath);
+	sizeofpath--;
+	as_path++;
 
-	eattr * new_attr = malloc(sizeof(eattr));
-	adata * new_data = malloc(sizeof(adata) + (4*sizeofpath));
+	adata * new_data = sce_alloc(sizeof(adata) + (4*sizeofpath) + 2);
 
 	new_data->length = sizeofpath*4 + 2;
 	new_data->data[0] = 2;
 	new_data->data[1] = sizeofpath;
 
-	int pos = 0;
-	for (int i = 2; i < (sizeofpath*4 + 2); i += 4) {
-		put_u32( (new_data->data+i), as_path[pos] );
-		pos++;
+	for (int i = 0; i < sizeofpath; i++)
+		put_u32(new_data->data + 2 + 4*i, as_path[i]);
+
+	return sce_attr_new(new_data);
+}
+
+/**
+ * Builds the AS_PATH attribute of the path @head continued by the rest of
+ * the path behind @tail. The tail is read in place, it is not decoded first.
+ * Returns NULL, if the tail contains an AS_SET or the path does not fit in one segment.
+ *
+ * @head: path of ASN, starting with the own ASN, which is not part of the attribute
+ * @len: number of ASN in @head
+ * @tail: iterator behind the last ASN of an AS_PATH that is not part of the new path
+ */
+static eattr * sce_path_join(const u32 * head, uint len, struct as_path_iter tail) {
+	// the remaining bytes of the tail are an upper bound of its ASN
+	uint max = (len - 1) + (tail.end - tail.pos) / 4;
+	adata * new_data = sce_alloc(sizeof(adata) + 2 + 4*max);
+	byte * pos = new_data->data + 2;
+
+	for (uint i = 1; i < len; i++, pos += 4)
+		put_u32(pos, head[i]);
+
+	u32 as;
+	while (as_path_iter_next(&tail, &as)) {
+		if (as_path_iter_in_set(&tail)) return NULL;
+
+		put_u32(pos, as);
+		pos += 4;
 	}
 
-	new_attr->id = 770;
-	new_attr->flags = 0x40;
-	new_attr->type = 6;
+	uint num = (pos - new_data->data - 2) / 4;
+	if (num > 255) return NULL;
 
-	new_attr->u.ptr = new_data;
+	new_data->length = pos - new_data->data;
+	new_data->data[0] = AS_PATH_SEQUENCE;
+	new_data->data[1] = num;
 
-	return new_attr;
+	return sce_attr_new(new_data);
+}
+
+/**
+ * Advances @it behind the next ASN @asn of its path that is not followed by @back,
+ * so the rest of the path is a tail that does not lead back over the contact.
+ * Returns 0 at the end of the path.
+ *
+ * @it: iterator over an AS_PATH
+ * @asn: the ASN the tail starts behind
+ * @back: the ASN the tail must not start with
+ */
+static _Bool sce_path_find_tail(struct as_path_iter * it, u32 asn, u32 back) {
+	u32 as;
+
+	while (as_path_iter_next(it, &as)) {
+		if ((as != asn) || as_path_iter_in_set(it)) continue;
+
+		struct as_path_iter next = *it;
+		if (as_path_iter_next(&next, &as) && (as == back)) continue;
+
+		return 1;
+	}
+
+	return 0;
 }
 
 /**
@@ -77,14 +252,14 @@ eattr * build_attr(u32 * as_path, u8 sizeofpath) {
  */
 ea_list * add_nexthop_attribute(struct nexthop * nh, ea_list * eal) {
 
-	struct adata * new_attrdata = malloc( 32 );
+	struct adata * new_attrdata = sce_alloc(sizeof(struct adata) + 2 * sizeof(ip_addr));
 	new_attrdata->length = 10;
 
 	ip_addr *nh_addr = (void *) new_attrdata->data;
 	nh_addr[0] = nh->gw;
 	nh_addr[1] = IPA_NONE;
 
-	ea_list * new_list = malloc(sizeof(ea_list) + sizeof(eattr)*2);
+	ea_list * new_list = sce_alloc(sizeof(ea_list) + sizeof(eattr)*2);
 	eattr * new_attr = &(new_list->attrs[0]);
 
 	new_list->flags = EALF_SORTED;
@@ -112,7 +287,7 @@ ea_list * add_nexthop_attribute(struct nexthop * nh, ea_list * eal) {
  */
 eattr * merge_head_tail(u32 * as_path1, u8 pos1, u32 * as_path2, u8 pos2, u8 length_of_2) {
 	int MAX_as_length = (pos1 + length_of_2) * 4;
-	u32 * new_as_path = malloc(MAX_as_length);
+	u32 * new_as_path = sce_alloc(MAX_as_length);
 
 
 	int pos = 0;
@@ -132,68 +307,92 @@ eattr * merge_head_tail(u32 * as_path1, u8 pos1, u32 * as_path2, u8 pos2, u8 len
 }
 
 /**
- * Searches for paths, that can complete the build-path with the appended
- * ASN from the scheduled contact entry
+ * Collects the AS paths of the routes @routes in an array, as the path computations
+ * also run on snapshots of them. The paths are not copied.
+ *
+ * @routes: the routes of a network
+ * @num: the number of the paths is stored here
+ */
+static const struct adata ** sce_route_paths(rte * routes, uint * num) {
+	uint count = 0;
+	for (rte * r = routes; r; r = r->next)
+		count++;
+
+	const struct adata ** paths = sce_alloc(count * sizeof(struct adata *));
+	*num = 0;
+
+	for (rte * r = routes; r; r = r->next) {
+		struct eattr * path_attr = get_as_path_attr(r);
+		if (path_attr)
+			paths[(*num)++] = path_attr->u.ptr;
+	}
+
+	return paths;
+}
+
+/**
+ * Searches the AS paths @paths for tails completing the build-path.
+ * The paths are scanned in place, a new path is only built for a found tail.
  *
  * @as_path: path that must be completed
  * @position: the position from where on the path must be completed
- * @num_of_segments: the total segment length of the build-path
- * @routes: all routes, where we search for paths to complete the build-path
+ * @paths: the AS paths to search in
+ * @num: number of the paths
  */
-attrs_holding * search_for_tail(u32 * as_path, u8 position, u8 num_of_segments, rte * routes) {
+static attrs_holding * sce_search_tails(u32 * as_path, uint position, const struct adata ** paths, uint num) {
 	u32 asn1 = as_path[position];
 	u32 search_asn = as_path[position + 1];
 
-	u8 count_new_paths = 0;
+	uint count_new_paths = 0;
+	struct as_path_iter it;
 
 	// count how many new routes are found
-	rte * current_route;
-	for (current_route = routes; current_route; current_route = current_route->next) {
-
-		struct eattr * path_attr = get_as_path_attr(current_route);
-		if (!(path_attr)) continue;
-
-		int num_of_segments_tmp = path_attr->u.ptr->data[1];
-		u32 * segments_search_in = get_as_path(path_attr);
-		for (int i = 0; i < num_of_segments_tmp; i++) {
-			if (segments_search_in[i] == search_asn
-					&& segments_search_in[i+1] != asn1) {
-				count_new_paths++;
-			}
-		}
+	for (uint i = 0; i < num; i++) {
+		as_path_iter_init(&it, paths[i]);
+		while (sce_path_find_tail(&it, search_asn, asn1))
+			count_new_paths++;
 	}
 
 	if (count_new_paths == 0) return NULL;
 
-	eattr * new_attrs = malloc(sizeof(eattr) * count_new_paths);
+	eattr * new_attrs = sce_alloc(sizeof(eattr) * count_new_paths);
 	int position_attrs = 0;
 
 	// for every tail a new eattr is build
-	for (current_route = routes; current_route; current_route = current_route->next) {
-
-		struct eattr * path_attr = get_as_path_attr(current_route);
-		if (!(path_attr)) continue;
-
-		int num_of_segments_tmp = path_attr->u.ptr->data[1];
-		u32 * segments_search_in = get_as_path(path_attr);
-
-		for (int i = 0; i < num_of_segments_tmp; i++) {
-			if (segments_search_in[i] == search_asn
-					&& segments_search_in[i+1] != asn1) {
-				eattr * new_attr = merge_head_tail(as_path, position + 1, segments_search_in, i, num_of_segments_tmp);
-				*(new_attrs+position_attrs) = *(new_attr);
-				position_attrs++;
-			}
+	for (uint i = 0; i < num; i++) {
+		as_path_iter_init(&it, paths[i]);
+		while (sce_path_find_tail(&it, search_asn, asn1)) {
+			eattr * new_attr = sce_path_join(as_path, position + 2, it);
+			if (new_attr)
+				new_attrs[position_attrs++] = *new_attr;
 		}
 	}
 
-	attrs_holding * new_holding = malloc(sizeof(attrs_holding));
-	new_holding->num_of_new = count_new_paths;
+	if (position_attrs == 0) return NULL;
+
+	attrs_holding * new_holding = sce_alloc(sizeof(attrs_holding));
+	new_holding->num_of_new = position_attrs;
 	new_holding->attrs = new_attrs;
 
 	return new_holding;
 }
 
+/**
+ * Searches for paths, that can complete the build-path with the appended
+ * ASN from the scheduled contact entry.
+ *
+ * @as_path: path that must be completed
+ * @position: the position from where on the path must be completed
+ * @num_of_segments: the total segment length of the build-path
+ * @routes: all routes, where we search for paths to complete the build-path
+ */
+attrs_holding * search_for_tail(u32 * as_path, u8 position, u8 num_of_segments UNUSED, rte * routes) {
+	uint num;
+	const struct adata ** paths = sce_route_paths(routes, &num);
+
+	return sce_search_tails(as_path, position, paths, num);
+}
+
 /**
  * Add an ASN to the path at the given index
  *
@@ -203,7 +402,7 @@ attrs_holding * search_for_tail(u32 * as_path, u8 position, u8 num_of_segments,
  * @asn: ASN that is inserted
  */
 u32 * extend_as_path(u32 * as_path, u8 index, u8 num_segments, u32 asn) {
-	u32 * new_as_path = malloc(num_segments * 4);
+	u32 * new_as_path = sce_alloc(num_segments * 4);
 
 	u8 border = index + 1;
 	for (int i = 0 ; i < num_segments; i++) {
@@ -215,7 +414,6 @@ u32 * extend_as_path(u32 * as_path, u8 index, u8 num_segments, u32 asn) {
 
 	new_as_path[border] = asn;
 
-	free(as_path);
 	return new_as_path;
 }
 
@@ -228,7 +426,7 @@ u32 * extend_as_path(u32 * as_path, u8 index, u8 num_segments, u32 asn) {
  * @asn: the asn that is inserted
  */
 u32 * add_first_segment(u32 * as_path, u8 num_segments, u32 asn) {
-	u32 * new_as_path = malloc(num_segments * 4);
+	u32 * new_as_path = sce_alloc(num_segments * 4);
 
 	for (int i = 1 ; i < num_segments; i++) {
 		new_as_path[i] = as_path[i-1];
@@ -236,7 +434,6 @@ u32 * add_first_segment(u32 * as_path, u8 num_segments, u32 asn) {
 
 	new_as_path[0] = asn;
 
-	free(as_path);
 	return new_as_path;
 }
 
@@ -247,38 +444,15 @@ u32 * add_first_segment(u32 * as_path, u8 num_segments, u32 asn) {
  * @num_segments: total segment length of the as_path
  */
 u32 * kick_first_segment(u32 * as_path, u8 num_segments) {
-	u32 * new_as_path = malloc(num_segments * 4);
+	u32 * new_as_path = sce_alloc(num_segments * 4);
 
 	for (int i = 0 ; i < num_segments; i++) {
 		new_as_path[i] = as_path[i+1];
 	}
 
-	free(as_path);
 	return new_as_path;
 }
 
-/**
- * Extract the the as path from an eattr.
- * The as path is an array of u32.
- *
- * @as_path_attr: the attribute where the as path is included
- */
-u32 * get_as_path(struct eattr * as_path_attr) {
-	u8 num_of_segments = (as_path_attr->u.ptr->length - 2)/4;
-	u32 * asns = malloc(num_of_segments * 4);
-
-	// first byte is type and second num. of segments
-	int pos = 2;
-
-	for (int i = 0; i < num_of_segments; i++) {
-		u32 segment = get_u32( as_path_attr->u.ptr->data + pos );
-		pos += 4;
-
-		asns[i] = segment;
-	}
-	return asns;
-}
-
 /**
  * Takes an u32 array and prints it to the console.
  *
@@ -304,8 +478,14 @@ void print_as_path_rt(rte * r) {
 		log(L_INFO "No path attribute in route!");
 		return;
 	}
-	u32 * tmp_p = get_as_path(tmp_a);
-	print_as_path(tmp_p, tmp_a->u.ptr->data[1]);
+	struct as_path_iter it;
+	u32 as;
+
+	log(L_INFO "===	AS_Path:");
+	as_path_iter_init(&it, tmp_a->u.ptr);
+	while (as_path_iter_next(&it, &as))
+		log(L_INFO "AS_SEGMENT: %u%s", as, as_path_iter_in_set(&it) ? " (set)" : "");
+	log(L_INFO "===	END AS_Path");
 }
 
 /**
@@ -326,160 +506,107 @@ _Bool check_equal_path(u32 * path1, u8 len_path1, u32 * path2, u8 len_path2) {
 }
 
 /**
- * Takes a set of eattr's and removes all duplicate paths.
+ * Takes a set of eattr's and removes all duplicate paths, the first one of each is kept.
+ * The paths are interned, so every path is looked up once in a hash table.
  *
  * @attr_h: the attrs_holding to search in
  */
 attrs_holding * remove_duplicates(attrs_holding * attr_h) {
+	if (attr_h->num_of_new < 2) return attr_h;
 
-	if (attr_h->num_of_new < 2) return NULL;
+	u32 stamp = ++sce_paths_stamp;
+	u8 num = 0;
 
-	for (int i = 0 ; i < attr_h->num_of_new ; i++) {
+	for (int i = 0; i < attr_h->num_of_new; i++) {
+		eattr * curr_attr = attr_h->attrs + i;
+		struct sce_path * path = sce_path_intern(curr_attr->u.ptr);
 
-		eattr * curr_attr = attr_h->attrs+i;
-		u32 * curr_path = get_as_path(curr_attr);
-		u8 curr_path_len = curr_attr->u.ptr->data[1];
+		if (path->seen == stamp) continue;
 
-		for (int y = 0 ; y < attr_h->num_of_new ; y++) {
-
-			if (i == y) continue;
-			eattr * tmp_attr = attr_h->attrs+y;
-			u32 * tmp_path = get_as_path(tmp_attr);
-			u8 tmp_path_len = tmp_attr->u.ptr->data[1];
+		path->seen = stamp;
+		attr_h->attrs[num] = *curr_attr;
+		attr_h->attrs[num].u.ptr = &path->ad;
+		num++;
+	}
 
-			_Bool same = 0;
-			// check if the paths are equal
-			same = check_equal_path(curr_path, curr_path_len, tmp_path, tmp_path_len);
+	attr_h->num_of_new = num;
 
-			// remove the corresponding eattr from the holding if they are equal
-			if (same) {
-				attr_h->num_of_new--;
-				for (int del_i = i; del_i < attr_h->num_of_new; del_i++) {
-					if (attr_h->attrs+del_i + 1) {
-						*(attr_h->attrs+del_i) = *(attr_h->attrs+del_i+1);
-					}
-				}
-			}
-		}
-	}
+	return attr_h;
 }
 
 /**
- * Takes an eattr and inserts the AS-AS pair from the scheduled contact entry.
- * If added, it searches for paths to complete the build-path from the position of the insertion on.
+ * Inserts the AS-AS pair from the scheduled contact entry into the AS path @path.
+ * If added, it searches the AS paths @paths for tails to complete the build-path
+ * from the position of the insertion on.
+ * The path is scanned in place, its head is copied only if the pair can be inserted.
  *
  * @entry: the schedued contact entry, where the AS-AS pair is stored
- * @attr: the AS_PATH attribute of a route
- * @routes: all routes that lead to a network
+ * @path: the AS path of a route
+ * @paths: the AS paths of all routes that lead to the network
+ * @num: number of the paths
  * @mypublicasn: the own ASN
  */
-struct attrs_holding * insert_sce_in_path(scheduled_contact_entry * entry, struct eattr * attr, rte * routes, u32 mypublicasn) {
+static attrs_holding * sce_insert_pair(scheduled_contact_entry * entry, const struct adata * path,
+		const struct adata ** paths, uint num, u32 mypublicasn) {
 	// TODO: Currently only supports ASN4: 4 byte asn numbers. Do I need support for 2 Byte ASN's?
 	u32 asn1 = entry->asn1;
 	u32 asn2 = entry->asn2;
 
-	u8 num_of_segments = attr->u.ptr->data[1];
-
-	if (num_of_segments < 2) return NULL;
+	if (as_path_getlen(path) < 2) return NULL;
 
-	// get path from eattr
-	u32 * as_path = get_as_path(attr);
+	// find the first ASN of the pair, the path starts with the own ASN
+	struct as_path_iter it;
+	as_path_iter_init(&it, path);
 
-	// add own asn to path
-	as_path = add_first_segment(as_path, ++num_of_segments, mypublicasn);
+	u32 as = mypublicasn;
+	uint index = 0;
 
-	// possible new path
-	struct eattr * new_attrs;
-	int num_of_new_attrs = 0;
-
-	// count how many new paths i.e. eattrs are build
-	for (int segment_index = 0; segment_index < num_of_segments; segment_index++) {
-		if (asn1 == as_path[segment_index]) {
-			// stop if asn pair is included already
-			if (asn2 == as_path[segment_index+1]) break;
-			// extend as_path to add asn2
-			num_of_segments++;
-			as_path = extend_as_path(as_path, segment_index, num_of_segments, asn2);
-
-			attrs_holding * result = search_for_tail(as_path, segment_index, num_of_segments, routes);
-
-			if ( result ) {
-				num_of_new_attrs += result->num_of_new;
-			}
-			break;
-		}
-		else if (asn2 == as_path[segment_index]) {
-			// stop if asn pair is included already
-			if (asn1 == as_path[segment_index+1]) break;
-			// extend as_path to add asn1
-			num_of_segments++;
-			as_path = extend_as_path(as_path, segment_index, num_of_segments, asn1);
-
-			attrs_holding * result = search_for_tail(as_path, segment_index, num_of_segments, routes);
-
-			if ( result ) {
-				num_of_new_attrs += result->num_of_new;
-			}
-			break;
-		}
+	while ((as != asn1) && (as != asn2)) {
+		// the hops of an AS_SET are unknown
+		if (!as_path_iter_next(&it, &as) || as_path_iter_in_set(&it)) return NULL;
+		index++;
 	}
 
-	if (num_of_new_attrs == 0) return NULL;
+	u32 other = (as == asn1) ? asn2 : asn1;
 
-	new_attrs = malloc(sizeof(struct eattr) * num_of_new_attrs);
-	int attr_index = 0;
+	// stop if asn pair is included already
+	u32 next;
+	if (as_path_iter_next(&it, &next) && (next == other)) return NULL;
 
-	// reset changes to as_path
-	free(as_path); // is extended from count section
-	num_of_segments = attr->u.ptr->data[1];
-	as_path = get_as_path(attr);
+	// the head of the new path is the path up to the found ASN, extended by the other one
+	u32 * as_path = sce_alloc((index + 2) * 4);
+	as_path[0] = mypublicasn;
 
-	as_path = add_first_segment(as_path, ++num_of_segments, mypublicasn);
+	as_path_iter_init(&it, path);
+	for (uint i = 1; i <= index; i++)
+		as_path_iter_next(&it, &as_path[i]);
 
-	// add new paths as eattr
-	for (int i = 0; i < num_of_segments; i++) {
-		if (asn1 == as_path[i]) {
-			// stop if asn pair is included already
-			if (asn2 == as_path[i+1]) break;
-			// extend as_path to add asn2
-			num_of_segments++;
-			as_path = extend_as_path(as_path, i, num_of_segments, asn2);
+	as_path[index + 1] = other;
 
-			attrs_holding * result = search_for_tail(as_path, i, num_of_segments, routes);
-			if (result->num_of_new > 0) {
-				for (int y = 0; y < result->num_of_new; y++) {
-					*(new_attrs+attr_index) = *(result->attrs+y);
-					attr_index++;
-				}
-			}
-			break;
-		}
-		else if (asn2 == as_path[i]) {
-			// stop if asn pair is included already
-			if (asn1 == as_path[i+1]) break;
-			// extend as_path to add asn1
-			num_of_segments++;
-			as_path = extend_as_path(as_path, i, num_of_segments, asn1);
-
-			attrs_holding * result = search_for_tail(as_path, i, num_of_segments, routes);
-			if (result->num_of_new > 0) {
-				for (int y = 0; y < result->num_of_new; y++) {
-					*(new_attrs+attr_index) = *(result->attrs+y);
-					attr_index++;
-				}
-			}
-			break;
-		}
-	}
-	attrs_holding * new_holding = malloc(sizeof(new_holding));
-	new_holding->num_of_new = num_of_new_attrs;
-	new_holding->attrs = new_attrs;
+	attrs_holding * new_holding = sce_search_tails(as_path, index, paths, num);
+	if (!new_holding) return NULL;
 
 	remove_duplicates(new_holding);
 
 	return new_holding;
 }
 
+/**
+ * Takes an eattr and inserts the AS-AS pair from the scheduled contact entry.
+ * If added, it searches for paths to complete the build-path from the position of the insertion on.
+ *
+ * @entry: the schedued contact entry, where the AS-AS pair is stored
+ * @attr: the AS_PATH attribute of a route
+ * @routes: all routes that lead to a network
+ * @mypublicasn: the own ASN
+ */
+struct attrs_holding * insert_sce_in_path(scheduled_contact_entry * entry, struct eattr * attr, rte * routes, u32 mypublicasn) {
+	uint num;
+	const struct adata ** paths = sce_route_paths(routes, &num);
+
+	return sce_insert_pair(entry, attr->u.ptr, paths, num, mypublicasn);
+}
+
 /**
  * Extract the AS_PATH attribute (eattr) from a route.
  *
@@ -505,42 +632,81 @@ struct eattr * get_as_path_attr(rte * route) {
  * The gateway is included in the scheduled contact entry.
  * After finding an neighbor, we put the informations in the rta @att structure.
  * This is necessary to set the appropriate next-hop in the routing table.
+ * Returns 0, if the gateway is not on a connected network, @att is not changed then.
  *
  * @att: route attributes where we put the informations of the next-hop
  * @p: bgp_proto struct to search for the neighbor
  * @entry: contains informations for the gateway
  */
-void add_next_hop(rta * att, struct bgp_proto * p, scheduled_contact_entry * entry) {
+_Bool add_next_hop(rta * att, struct bgp_proto * p, scheduled_contact_entry * entry) {
 
-	ip_addr * nh = malloc(sizeof(nh));
+	ip_addr nh = IPA_NONE;
 
 	if (entry->asn1 == p->public_as) {
-		*nh = ipa_from_ip4( entry->gw1  );
+		nh = ipa_from_ip4( entry->gw1  );
 	} else if (entry->asn2 == p->public_as ) {
-		*nh = ipa_from_ip4( entry->gw2 );
+		nh = ipa_from_ip4( entry->gw2 );
 	} else {
 		// print error message: no matching asn
 	}
 	neighbor * neigh = NULL;
-	neigh =	neigh_find(&p->p, *nh, NULL, 0);
+	neigh =	neigh_find(&p->p, nh, NULL, 0);
 
-	if ( !(neigh) ) log(L_INFO "Did not find an interface for IP Address: %x (hex)", nh->addr[3]);
+	if ( !(neigh) ) {
+		log(L_INFO "Did not find an interface for IP Address: %I", nh);
+		return 0;
+	}
 
 	att->dest = RTD_UNICAST;
 	att->nh.gw = neigh->addr;
 	att->nh.iface = neigh->iface;
+	return 1;
+}
+
+/*
+ * Prepends the attribute EA_GEN_SCE of a route over the contact @entry, whose
+ * window ends at @end, to the attributes @eal.
+ */
+static ea_list * sce_contact_attr(ea_list * eal, scheduled_contact_entry * entry, u64 end) {
+	sce_key key = sce_get_key(entry);
+
+	struct adata * ad = sce_alloc(sizeof(struct adata) + SCE_EA_LENGTH);
+	ad->length = SCE_EA_LENGTH;
+	put_u64(ad->data, end);
+	put_u32(ad->data + 8, key.asn_lo);
+	put_u32(ad->data + 12, key.asn_hi);
+
+	ea_list * l = sce_alloc(sizeof(ea_list) + sizeof(eattr));
+	l->next = eal;
+	l->flags = EALF_SORTED;
+	l->count = 1;
+	l->attrs[0] = (eattr) { .id = EA_GEN_SCE, .type = EAF_TYPE_OPAQUE, .u.ptr = ad };
+
+	return l;
 }
 
 /**
- * If we found a new path, we construct a new route that contains this path.
- * We use the old rte as template for some attributes.
+ * Returns 1, if both AS paths start with the same neighbor AS, i.e. with the same
+ * ASN in an AS_SEQUENCE. The neighbor of a path starting with an AS_SET is not known.
  *
- * @rt: pointer to the address of the template-rte (old route)
- * @new_as_path: the new as path attribute
- * @p: bgp_proto struct
- * @entry: the scheduled_contact_entry where the new route originated from
+ * @path1: the first as path
+ * @path2: the second as path
  */
-rte * copy_rte_and_insert_as_path(rte ** rt, struct eattr * new_as_path, struct bgp_proto * p, scheduled_contact_entry * entry) {
+_Bool sce_path_same_neighbor(const struct adata * path1, const struct adata * path2) {
+	struct as_path_iter it1, it2;
+	u32 as1, as2;
+
+	as_path_iter_init(&it1, path1);
+	as_path_iter_init(&it2, path2);
+
+	return as_path_iter_next(&it1, &as1) && as_path_iter_next(&it2, &as2) && (as1 == as2) &&
+		!as_path_iter_in_set(&it1) && !as_path_iter_in_set(&it2);
+}
+
+/*
+ * Builds the new route of copy_rte_and_insert_as_path(), whose window ends at @end.
+ */
+static rte * sce_route_copy(rte ** rt, struct eattr * new_as_path, struct bgp_proto * p, scheduled_contact_entry * entry, u64 end) {
 
 	rta * old_rta = (*rt)->attrs;
 
@@ -548,11 +714,10 @@ rte * copy_rte_and_insert_as_path(rte ** rt, struct eattr * new_as_path, struct
 	ea_list * eal_new = NULL;
 
 	while ( !(eal_new) ) {
-		eal_new = malloc( sizeof(*eal_old) * (eal_old->count * sizeof(eattr)) );
+		eal_new = sce_alloc( sizeof(*eal_old) * (eal_old->count * sizeof(eattr)) );
 		memcpy(eal_new, eal_old, sizeof(*eal_old) * (eal_old->count * sizeof(eattr)));
 
 		if ( !(ea_find(eal_new, EA_CODE(PROTOCOL_BGP, BA_AS_PATH))) ) {
-			free(eal_new);
 			eal_old = eal_old->next;
 		}
 	}
@@ -563,18 +728,15 @@ rte * copy_rte_and_insert_as_path(rte ** rt, struct eattr * new_as_path, struct
 	// only needs new next hop, when the first path segment differs
 	_Bool needs_new_nh = 0;
 
-	u32 * new_as = get_as_path(new_as_path);
 	eattr * old_path_attr = ea_find(eal_old, EA_CODE(PROTOCOL_BGP, BA_AS_PATH));
-	u32 * old_as = get_as_path(old_path_attr);
-
-	if (new_as[0] != old_as[0]) needs_new_nh = 1;
+	if (!sce_path_same_neighbor(new_as_path->u.ptr, old_path_attr->u.ptr)) needs_new_nh = 1;
 
 	rta * new_rta = allocz(RTA_MAX_SIZE);
 
 	new_rta->source = RTS_BGP;
 	new_rta->scope = SCOPE_UNIVERSE;
 	new_rta->from = old_rta->from;
-	new_rta->eattrs = eal_new;
+	new_rta->eattrs = sce_contact_attr(eal_new, entry, end);
 	new_rta->dest = RTD_UNICAST;
 	new_rta->igp_metric = old_rta->igp_metric;
 	new_rta->src = old_rta->src;
@@ -588,14 +750,27 @@ rte * copy_rte_and_insert_as_path(rte ** rt, struct eattr * new_as_path, struct
 	nrt->u.bgp.suppressed = 0;
 	nrt->u.bgp.stale = -1;
 
-	if (needs_new_nh) {
-		add_next_hop( nrta, p, entry );
-	} else {
+	// the next hop of the template is kept, if the gateway of the contact is not reachable
+	if ( !(needs_new_nh) || !(add_next_hop( nrta, p, entry )) ) {
 		nrta->nh = old_rta->nh;
 	}
 	return nrt;
 }
 
+/**
+ * If we found a new path, we construct a new route that contains this path.
+ * We use the old rte as template for some attributes.
+ * The contact is recorded in the attribute EA_GEN_SCE of the route.
+ *
+ * @rt: pointer to the address of the template-rte (old route)
+ * @new_as_path: the new as path attribute
+ * @p: bgp_proto struct
+ * @entry: the scheduled_contact_entry where the new route originated from
+ */
+rte * copy_rte_and_insert_as_path(rte ** rt, struct eattr * new_as_path, struct bgp_proto * p, scheduled_contact_entry * entry) {
+	return sce_route_copy(rt, new_as_path, p, entry, entry->start_time + entry->duration);
+}
+
 /**
  * Print the next-hop of a route.
  *
@@ -613,441 +788,2898 @@ void print_nexthop(rte * rt) {
 }
 
 /**
- * Check if the new route is unique among all others.
- * Check with the path, the destination and the next-hop.
+ * Check if the new route is unique among all other routes of its network.
+ * Check with the path and the next-hop.
  *
  * @rt: the route that is checked for uniqueness
- * @table: the table in which to search for
- * @ ipv4address: the destination network's IPv4 address
+ * @n: the network of the route
  */
-_Bool is_unique_route(rte * rt, rtable * table, u32 * ipv4_address) {
+_Bool is_unique_route(rte * rt, net * n) {
 
-	if (rt == NULL || table == NULL || ipv4_address == NULL) return 0;
+	if (rt == NULL || n == NULL) return 0;
 
 	// get AS_PATH
 	eattr * new_as_path_attr = get_as_path_attr(rt);
 	if (new_as_path_attr == NULL) return 0;
-	u8 new_len_as_path = new_as_path_attr->u.ptr->data[1];
-	u32 * new_as_path = get_as_path(new_as_path_attr);
-
-	// get Next-Hop
-	u32 * new_nh = &rt->attrs->nh.gw.addr[0];
-
-	FIB_WALK(&(table->fib), net, n) {
-		rte* oldroute;
-		for (oldroute = n->routes; oldroute; oldroute = oldroute->next) {
-			// get AS_PATH
-			eattr * old_as_path_attr = get_as_path_attr(oldroute);
-			if (old_as_path_attr == NULL) continue;
-			u8 old_len_as_path = old_as_path_attr->u.ptr->data[1];
-			u32 * old_as_path = get_as_path(old_as_path_attr);
-
-			// get Next-Hop
-			u32 * old_nh = &rt->attrs->nh.gw.addr[0];
-			_Bool same_nh = (new_nh[0] == old_nh[0]) && (new_nh[1] == old_nh[1])
-							&& (new_nh[2] == old_nh[2]) && (new_nh[3] == old_nh[3]);
-
-			// get IPv4 address (destination network)
-			u8 * old_net_ip = &oldroute->net->n.addr[0].data;
-			// cast the u8 pointer to an u32 pointer to get access to the whole 32 bit IPv4 address in the array
-			_Bool same_ip = *(ipv4_address) == *((u32 *) old_net_ip);
-
-			if (same_nh && same_ip &&
-				check_equal_path(new_as_path, new_len_as_path, old_as_path, old_len_as_path) ) {
-				return 0;
-			}
 
+	for (rte * oldroute = n->routes; oldroute; oldroute = oldroute->next) {
+		// get AS_PATH
+		eattr * old_as_path_attr = get_as_path_attr(oldroute);
+		if (old_as_path_attr == NULL) continue;
+
+		if (ipa_equal(rt->attrs->nh.gw, oldroute->attrs->nh.gw) &&
+			adata_same(new_as_path_attr->u.ptr, old_as_path_attr->u.ptr)) {
+			return 0;
 		}
 	}
-	FIB_WALK_END;
 
 	return 1;
 }
 
+
 /*
- * Is called after a scheduled contact begins.
- * Traverses all routes and adds the AS-AS pair from the scheduled contact entry.
- * Here we want to find new routes that becomme possible due to the contact.
- *
- * @ed: entry_data struct that contains various informations needed for this process.
+ * Index of AS pairs
  */
-void modify_routingtable_add(entry_data *ed) {
 
-	// get table and sce and check if exists
-	struct bgp_proto * proto = ed->proto;
-	u32 mypublicasn = proto->public_as;
+#define SCEP_KEY(p)		p->asn1, p->asn2
+#define SCEP_NEXT(p)		p->next
+#define SCEP_EQ(a1,a2,b1,b2)	a1 == b1 && a2 == b2
+#define SCEP_FN(a1,a2)		u32_hash(a1) ^ u32_hash(a2 * 3)
 
-	struct channel * chl = ed->ch;
-	struct rtable *table;
-	scheduled_contact_entry * entry = ed->sce;
+#define SCEP_REHASH		sce_pair_rehash
+#define SCEP_PARAMS		/8, *2, 2, 2, 10, 24
 
-	if (chl) table = chl->table;
-	else return;
+HASH_DEFINE_REHASH_FN(SCEP, struct sce_pair)
 
-	if ( !(table) || !(&(table->fib)) || !(entry) ) return;
+#define SCEPN_KEY(pn)		pn->pair, pn->net
+#define SCEPN_NEXT(pn)		pn->next
+#define SCEPN_EQ(p1,n1,p2,n2)	p1 == p2 && n1 == n2
+#define SCEPN_FN(p,n)		ptr_hash(p) ^ ptr_hash(n)
 
-	_Bool rt_change = 0;
+#define SCEPN_REHASH		sce_pair_net_rehash
+#define SCEPN_PARAMS		/8, *2, 2, 2, 10, 26
 
-	FIB_WALK(&(table->fib), net, n) {
+HASH_DEFINE_REHASH_FN(SCEPN, struct sce_pair_net)
 
-		rte* oldroute;
+#define SCEA_KEY(a)		a->asn
+#define SCEA_NEXT(a)		a->next
+#define SCEA_EQ(a,b)		a == b
+#define SCEA_FN(a)		u32_hash(a)
 
-		for (oldroute = n->routes; oldroute; oldroute = oldroute->next) {
-			struct eattr * as_path_attr = get_as_path_attr(oldroute);
+#define SCEA_REHASH		sce_as_rehash
+#define SCEA_PARAMS		/8, *2, 2, 2, 8, 20
 
-			if (as_path_attr) {
+HASH_DEFINE_REHASH_FN(SCEA, struct sce_as)
 
-				attrs_holding * new_as_path_attr = insert_sce_in_path(entry, as_path_attr, n->routes, mypublicasn);
+static void sce_index_as_link(struct sce_index * idx, u32 asn, struct sce_pair * pair) {
+	struct sce_as * a = HASH_FIND(idx->ases, SCEA, asn);
 
-				if (new_as_path_attr) {
-					for (int i = 0; i < new_as_path_attr->num_of_new; i++) {
-						eattr * tmp_attr = new_as_path_attr->attrs+i;
-						rte * new_rte = copy_rte_and_insert_as_path(&oldroute, tmp_attr, proto, entry);
+	if (!a) {
+		a = sl_allocz(idx->as_slab);
+		a->asn = asn;
+		BUFFER_INIT(a->pairs, idx->pool, 4);
+		HASH_INSERT2(idx->ases, SCEA, idx->pool, a);
+	}
 
-						_Bool unique_route = is_unique_route(new_rte, table, ((u32 *) &n->n.addr[0].data) );
+	BUFFER_PUSH(a->pairs) = pair;
+}
 
-						if (!unique_route) {
-							// if the route was not unique, we can delete it
-							rte_free(new_rte);
-							continue;
-						}
+static void sce_index_as_unlink(struct sce_index * idx, u32 asn, struct sce_pair * pair) {
+	struct sce_as * a = HASH_FIND(idx->ases, SCEA, asn);
+	if (!a) return;
 
-						// flags to identify this route in rte_announce
-						new_rte->pflags = 0x99;
-						rte_update3(chl, &(n->n.addr), new_rte, chl->proto->main_source);
-						rt_change = 1;
-					}
-				}
-			}
+	for (uint i = 0; i < a->pairs.used; i++)
+		if (a->pairs.data[i] == pair) {
+			a->pairs.data[i] = a->pairs.data[--a->pairs.used];
+			break;
 		}
-	}
-	FIB_WALK_END;
-}
 
+	if (a->pairs.used) return;
 
-/*
- * Checks if a path contains the AS-AS pair and if so it returns 1,
- * indicating that we should remove this route, when a contact ends.
+	HASH_REMOVE2(idx->ases, SCEA, idx->pool, a);
+	mb_free(a->pairs.data);
+	sl_free(idx->as_slab, a);
+}
+
+/**
+ * Adds @diff to the number of occurrences of the AS pair in routes of network @n.
  *
- * @entry: the scheduled_contact_entry containing the AS-AS pair
- * @as_path_attr: the AS_PATH attribute
- * @mypublicasn: the own ASN
+ * @idx: the index
+ * @n: the network
+ * @asn1: the first ASN of the pair or SCE_PAIR_START
+ * @asn2: the second ASN of the pair
+ * @diff: 1 when a route was added, -1 when a route was removed
  */
+static void sce_index_pair(struct sce_index * idx, net * n, u32 asn1, u32 asn2, int diff) {
+	if ((asn1 > asn2) && (asn2 != SCE_PAIR_START)) {
+		u32 tmp = asn1; asn1 = asn2; asn2 = tmp;
+	}
 
-_Bool path_contains_as_pair(scheduled_contact_entry * entry, eattr * as_path_attr, u32 mypublicasn) {
-	u32 asn1 = entry->asn1;
-	u32 asn2 = entry->asn2;
-	u8 num_segments = (as_path_attr->u.ptr->length - 2)/4;
-	u32 * path = get_as_path(as_path_attr);
-
-	path = add_first_segment(path, ++num_segments, mypublicasn);
+	struct sce_pair * pair = HASH_FIND(idx->pairs, SCEP, asn1, asn2);
 
-	for (int i = 0; i < num_segments; i++) {
-		if ( path[i] == asn1  && path[i+1] == asn2 ) return 1;
-		if ( path[i] == asn2  && path[i+1] == asn1 ) return 1;
-	}
+	if (!pair) {
+		if (diff < 0) return;
 
-	return 0;
-}
+		pair = sl_allocz(idx->pair_slab);
+		pair->asn1 = asn1;
+		pair->asn2 = asn2;
+		init_list(&pair->nets);
+		HASH_INSERT2(idx->pairs, SCEP, idx->pool, pair);
 
-/**
- * Is called after a scheduled contact ends.
- * Traverses all routes and checks which route contains the AS-AS pair from the sce.
- * If a route contains the pair, we add a specific flag and call rte_update3() where the route is deleted.
- *
- * @ed: entry_data struct that contains various informations needed for this process.
- */
-void modify_routingtable_remove(entry_data *ed) {
-	// get table and sce and chek if exists
-	struct bgp_proto * proto = ed->proto;
-	u32 mypublicasn = proto->public_as;
+		if (asn1 != SCE_PAIR_START)
+			sce_index_as_link(idx, asn1, pair);
+		sce_index_as_link(idx, asn2, pair);
+	}
 
-	struct channel * chl = ed->ch;
-	struct rtable *table;
-	scheduled_contact_entry * entry = ed->sce;
+	struct sce_pair_net * pn = HASH_FIND(idx->nets, SCEPN, pair, n);
 
+	if (!pn) {
+		if (diff < 0) return;
 
-	if (chl) table = chl->table;
-	else return;
+		pn = sl_allocz(idx->net_slab);
+		pn->pair = pair;
+		pn->net = n;
+		HASH_INSERT2(idx->nets, SCEPN, idx->pool, pn);
+		add_tail(&pair->nets, &pn->n);
+	}
 
-	if ( !(table) || !(&(table->fib)) || !(entry) ) return;
+	pn->count += diff;
+	if (pn->count) return;
 
-	FIB_WALK(&(table->fib), net, n) {
+	// the last route of the network with this pair disappeared
+	HASH_REMOVE2(idx->nets, SCEPN, idx->pool, pn);
+	rem_node(&pn->n);
+	sl_free(idx->net_slab, pn);
 
-		rte* oldroute;
+	if (!EMPTY_LIST(pair->nets)) return;
 
-		for (oldroute = n->routes; oldroute; oldroute = oldroute->next) {
-			struct eattr * as_path_attr = get_as_path_attr(oldroute);
+	if (asn1 != SCE_PAIR_START)
+		sce_index_as_unlink(idx, asn1, pair);
+	sce_index_as_unlink(idx, asn2, pair);
+	HASH_REMOVE2(idx->pairs, SCEP, idx->pool, pair);
+	sl_free(idx->pair_slab, pair);
+}
 
-			if (as_path_attr) {
-				_Bool routewithdraw = path_contains_as_pair(entry, as_path_attr, mypublicasn);
-				// the route contains the AS-AS pair so we remove this route
-				if (routewithdraw) {
-					// flags to identify this route in rte_announce
-					oldroute->pflags = 0x77;
-					rte_update3(chl, &(n->n.addr), oldroute, chl->proto->main_source);
-				}
-			}
+/**
+ * Adds or removes all AS pairs of the AS path of route @r.
+ * Segment boundaries are ignored and prepended ASNs are counted once.
+ *
+ * @idx: the index
+ * @n: the network of the route
+ * @r: the route
+ * @diff: 1 when the route was added, -1 when it was removed
+ */
+static void sce_index_route(struct sce_index * idx, net * n, rte * r, int diff) {
+	eattr * a = get_as_path_attr(r);
+	if (!a) return;
+
+	const byte * pos = a->u.ptr->data;
+	const byte * end = pos + a->u.ptr->length;
+	u32 prev = SCE_PAIR_START;
+
+	while (pos + 2 <= end) {
+		uint len = pos[1];
+		pos += 2;
+
+		for (uint i = 0; (i < len) && (pos + 4 <= end); i++, pos += 4) {
+			u32 asn = get_u32(pos);
+			if (asn != prev)
+				sce_index_pair(idx, n, prev, asn, diff);
+			prev = asn;
 		}
 	}
-	FIB_WALK_END;
 }
 
-/*
- * Timer Registration
- */
+static void sce_stage_touch(struct sce_index * idx, net * n);
 
+/**
+ * Returns the AS pair index of a table. The index is built on first use
+ * and kept up to date by rte_recalculate() afterwards.
+ *
+ * @table: the routing table
+ */
+struct sce_index * sce_index_get(rtable * table) {
+	if (table->sce_index) return table->sce_index;
+
+	pool * p = rp_new(table->rp, "SCE index");
+	struct sce_index * idx = mb_allocz(p, sizeof(struct sce_index));
+	idx->pool = p;
+	idx->table = table;
+	idx->pair_slab = sl_new(p, sizeof(struct sce_pair));
+	idx->net_slab = sl_new(p, sizeof(struct sce_pair_net));
+	idx->as_slab = sl_new(p, sizeof(struct sce_as));
+	HASH_INIT(idx->pairs, p, 10);
+	HASH_INIT(idx->nets, p, 10);
+	HASH_INIT(idx->ases, p, 8);
+	init_list(&idx->stages);
+
+	FIB_WALK(&table->fib, net, n) {
+		for (rte * r = n->routes; r; r = r->next)
+			sce_index_route(idx, n, r, 1);
+	}
+	FIB_WALK_END;
+
+	table->sce_index = idx;
+	return idx;
+}
+
+/**
+ * Called by rte_recalculate(), when route @old was replaced by route @new in network @n.
+ * Both can be NULL.
+ *
+ * @idx: the index
+ * @n: the network
+ * @new: the added route
+ * @old: the removed route
+ */
+void sce_index_update(struct sce_index * idx, net * n, rte * new, rte * old) {
+	if (old) sce_index_route(idx, n, old, -1);
+	if (new) sce_index_route(idx, n, new, 1);
+
+	if (!EMPTY_LIST(idx->stages))
+		sce_stage_touch(idx, n);
+}
+
+static int sce_net_cmp(const void * a, const void * b) {
+	const net * x = *(const net **) a;
+	const net * y = *(const net **) b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * Sorts the array of networks and removes duplicates.
+ * Returns the new number of networks.
+ */
+static uint sce_nets_unique(net ** nets, uint count) {
+	if (count < 2) return count;
+
+	qsort(nets, count, sizeof(net *), sce_net_cmp);
+
+	uint j = 1;
+	for (uint i = 1; i < count; i++)
+		if (nets[i] != nets[j-1])
+			nets[j++] = nets[i];
+
+	return j;
+}
+
+/**
+ * Collects all networks with a route containing the AS pair @asn1 @asn2.
+ * If one of them is SCE_PAIR_START, the networks with a route starting with the other ASN are found.
+ * Returns the number of networks, the array is allocated from the index pool and must be freed with mb_free().
+ *
+ * @idx: the index
+ * @asn1: the first ASN
+ * @asn2: the second ASN
+ * @nets: will point to the array of networks
+ */
+uint sce_index_pair_nets(struct sce_index * idx, u32 asn1, u32 asn2, net *** nets) {
+	if ((asn1 > asn2) && (asn2 != SCE_PAIR_START)) {
+		u32 tmp = asn1; asn1 = asn2; asn2 = tmp;
+	}
+
+	struct sce_pair * pair = HASH_FIND(idx->pairs, SCEP, asn1, asn2);
+	BUFFER_(net *) buf;
+	BUFFER_INIT(buf, idx->pool, 16);
+
+	if (pair) {
+		struct sce_pair_net * pn;
+		WALK_LIST(pn, pair->nets)
+			BUFFER_PUSH(buf) = pn->net;
+	}
+
+	*nets = buf.data;
+	return buf.used;
+}
+
+/**
+ * Collects all networks with a route containing the ASN @asn.
+ * Returns the number of networks, the array is allocated from the index pool and must be freed with mb_free().
+ *
+ * @idx: the index
+ * @asn: the ASN
+ * @nets: will point to the array of networks
+ */
+uint sce_index_as_nets(struct sce_index * idx, u32 asn, net *** nets) {
+	struct sce_as * a = HASH_FIND(idx->ases, SCEA, asn);
+	BUFFER_(net *) buf;
+	BUFFER_INIT(buf, idx->pool, 16);
+
+	if (a) {
+		for (uint i = 0; i < a->pairs.used; i++) {
+			struct sce_pair_net * pn;
+			WALK_LIST(pn, a->pairs.data[i]->nets)
+				BUFFER_PUSH(buf) = pn->net;
+		}
+	}
+
+	*nets = buf.data;
+	return sce_nets_unique(buf.data, buf.used);
+}
+
+/*
+ * Routes prepared ahead of a contact
+ */
+
+#define SCESN_KEY(sn)		sn->net
+#define SCESN_NEXT(sn)		sn->next
+#define SCESN_EQ(a,b)		a == b
+#define SCESN_FN(n)		ptr_hash(n)
+
+#define SCESN_REHASH		sce_stage_net_rehash
+#define SCESN_PARAMS		/8, *2, 2, 2, 6, 20
+
+HASH_DEFINE_REHASH_FN(SCESN, struct sce_stage_net)
+
+static struct sce_stage_net * sce_stage_net_get(struct sce_stage * stg, net * n) {
+	struct sce_stage_net * sn = HASH_FIND(stg->nets, SCESN, n);
+	if (sn) return sn;
+
+	sn = lp_allocz(stg->lp, sizeof(struct sce_stage_net));
+	sn->net = n;
+	HASH_INSERT2(stg->nets, SCESN, stg->pool, sn);
+
+	return sn;
+}
+
+static void sce_stage_net_flush(struct sce_stage * stg, struct sce_stage_net * sn) {
+	for (struct sce_stage_route * sr = sn->routes; sr; sr = sr->next) {
+		rta_free(sr->tmpl);
+		stg->routes--;
+	}
+
+	sn->routes = NULL;
+}
+
+static void sce_stage_net_touch(struct sce_stage * stg, net * n) {
+	struct sce_stage_net * sn = sce_stage_net_get(stg, n);
+	if (sn->dirty) return;
+
+	sce_stage_net_flush(stg, sn);
+	sn->dirty = 1;
+}
+
+/**
+ * Marks network @n as changed in all stages of the index.
+ * Its prepared routes are dropped, they are computed again when the contact begins.
+ * Stages computed by the worker are marked once they are done.
+ *
+ * @idx: the index
+ * @n: the network with a changed route
+ */
+static void sce_stage_touch(struct sce_index * idx, net * n) {
+	struct sce_stage * stg;
+
+	WALK_LIST(stg, idx->stages) {
+		if (!stg->busy) {
+			sce_stage_net_touch(stg, n);
+			continue;
+		}
+
+		if (!stg->touched.data)
+			BUFFER_INIT(stg->touched, idx->pool, 16);
+
+		BUFFER_PUSH(stg->touched) = n;
+	}
+}
+
+/**
+ * Takes the snapshot of the networks @nets for the computation of stage @stg.
+ * The templates are referenced, so their AS paths stay valid until the stage is done.
+ *
+ * @stg: the stage
+ * @nets: the networks with a route over the other ASN of the contact
+ * @num: number of the networks
+ */
+static void sce_stage_snap(struct sce_stage * stg, net ** nets, uint num) {
+	stg->snap = lp_allocz(stg->lp, num * sizeof(struct sce_snap_net));
+	stg->snap_nets = num;
+
+	for (uint k = 0; k < num; k++) {
+		struct sce_snap_net * sn = &stg->snap[k];
+		uint count = 0;
+
+		for (rte * r = nets[k]->routes; r; r = r->next)
+			count++;
+
+		sn->net = nets[k];
+		sn->tmpls = lp_alloc(stg->lp, count * sizeof(rta *));
+		sn->paths = lp_alloc(stg->lp, count * sizeof(struct adata *));
+
+		for (rte * r = nets[k]->routes; r; r = r->next) {
+			struct eattr * as_path_attr = get_as_path_attr(r);
+			if (!as_path_attr) continue;
+
+			sn->tmpls[sn->num] = rta_clone(r->attrs);
+			sn->paths[sn->num] = as_path_attr->u.ptr;
+			sn->num++;
+		}
+	}
+}
+
+static void sce_stage_unsnap(struct sce_stage * stg) {
+	for (uint k = 0; k < stg->snap_nets; k++)
+		for (uint i = 0; i < stg->snap[k].num; i++)
+			rta_free(stg->snap[k].tmpls[i]);
+
+	stg->snap = NULL;
+	stg->snap_nets = 0;
+}
+
+/**
+ * Computes the new AS paths of up to @max networks of the snapshot of stage @stg.
+ * The paths are computed like in modify_routingtable_add(). Only the snapshot and
+ * the stage are used, so it may run in the worker thread.
+ * Returns 1, when all networks are done.
+ *
+ * @stg: the stage
+ * @max: the maximal number of networks
+ */
+static _Bool sce_stage_compute(struct sce_stage * stg, uint max) {
+	uint end = MIN(stg->snap_pos + max, stg->snap_nets);
+
+	for (; stg->snap_pos < end; stg->snap_pos++) {
+		struct sce_snap_net * snap = &stg->snap[stg->snap_pos];
+
+		for (uint i = 0; i < snap->num; i++) {
+			attrs_holding * h = sce_insert_pair(&stg->e, snap->paths[i], snap->paths, snap->num, stg->own);
+			if (!h) continue;
+
+			struct sce_stage_net * sn = sce_stage_net_get(stg, snap->net);
+
+			for (int k = 0; k < h->num_of_new; k++) {
+				const struct adata * ad = h->attrs[k].u.ptr;
+				struct adata * copy = lp_alloc(stg->lp, sizeof(struct adata) + ad->length);
+				memcpy(copy, ad, sizeof(struct adata) + ad->length);
+
+				struct sce_stage_route * sr = lp_alloc(stg->lp, sizeof(struct sce_stage_route));
+				sr->tmpl = snap->tmpls[i];
+				sr->attr = h->attrs[k];
+				sr->attr.u.ptr = copy;
+				sr->next = sn->routes;
+				sn->routes = sr;
+				stg->routes++;
+			}
+		}
+	}
+
+	sce_scratch_flush();
+
+	return stg->snap_pos == stg->snap_nets;
+}
+
+/**
+ * Called in the main loop when the computation of stage @stg is done.
+ * The prepared routes take their own references to the templates and
+ * the networks changed meanwhile are marked dirty.
+ *
+ * @stg: the stage
+ */
+static void sce_stage_done(struct sce_stage * stg) {
+	stg->busy = 0;
+
+	if (stg->cancelled) {
+		sce_stage_free(stg);
+		return;
+	}
+
+	HASH_WALK(stg->nets, next, sn) {
+		for (struct sce_stage_route * sr = sn->routes; sr; sr = sr->next)
+			rta_clone(sr->tmpl);
+	}
+	HASH_WALK_END;
+
+	sce_stage_unsnap(stg);
+
+	for (uint i = 0; i < stg->touched.used; i++)
+		sce_stage_net_touch(stg, stg->touched.data[i]);
+
+	if (stg->touched.data)
+		mb_free(stg->touched.data);
+
+	stg->touched = (typeof(stg->touched)) {};
+}
+
+/**
+ * Prepares the routes over the contact @ed for its begin.
+ * A snapshot of the affected networks is taken and computed by the worker thread,
+ * if there is one. Otherwise it is computed right away.
+ * Returns NULL, if the channel has no table.
+ *
+ * @ed: the contact with its channel and protocol
+ */
+static struct sce_stage * sce_stage_prepare(entry_data * ed) {
+	struct channel * chl = ed->ch;
+	if (!chl || !chl->table) return NULL;
+
+	scheduled_contact_entry * entry = ed->sce;
+	u32 mypublicasn = ed->proto->public_as;
+	struct sce_index * idx = sce_index_get(chl->table);
+
+	pool * p = rp_new(idx->pool, "SCE stage");
+	struct sce_stage * stg = mb_allocz(p, sizeof(struct sce_stage));
+	stg->pool = p;
+	stg->lp = lp_new_default(p);
+	stg->idx = idx;
+	stg->e = *entry;
+	stg->own = mypublicasn;
+	HASH_INIT(stg->nets, p, 6);
+
+	u32 search_asn = (entry->asn1 == mypublicasn) ? entry->asn2 : entry->asn1;
+
+	net ** nets;
+	uint num_nets = sce_index_as_nets(idx, search_asn, &nets);
+	sce_stage_snap(stg, nets, num_nets);
+	mb_free(nets);
+
+	add_tail(&idx->stages, &stg->n);
+
+	stg->busy = 1;
+	if (sce_worker_queue(stg))
+		return stg;
+
+	sce_stage_compute(stg, stg->snap_nets);
+	sce_stage_done(stg);
+
+	return stg;
+}
+
+static void sce_worker_cancel(struct sce_stage * stg);
+
+/**
+ * Releases the stage @stg and the references to the template routes.
+ * A stage computed by the worker is released once the worker is done with it.
+ *
+ * @stg: the stage, may be NULL
+ */
+void sce_stage_free(struct sce_stage * stg) {
+	if (!stg) return;
+
+	if (stg->n.next)
+		rem_node(&stg->n);
+
+	if (stg->busy) {
+		sce_worker_cancel(stg);
+		return;
+	}
+
+	// the prepared routes of an unfinished stage only borrow the templates of the snapshot
+	if (stg->snap)
+		sce_stage_unsnap(stg);
+	else {
+		HASH_WALK(stg->nets, next, sn)
+			sce_stage_net_flush(stg, sn);
+		HASH_WALK_END;
+	}
+
+	if (stg->touched.data)
+		mb_free(stg->touched.data);
+
+	rfree(stg->pool);
+}
+
+/*
+ * SCE worker thread
+ */
+
+#ifdef CONFIG_BFD
+
+#include <pthread.h>
+#include "proto/bfd/io.h"
+#include "lib/socket.h"
+
+/* The main loop is notified by a pipe like in BFD */
+int pipe(int pipefd[2]);
+void pipe_drain(int fd);
+void pipe_kick(int fd);
+
+static struct sce_worker {
+	struct birdloop * loop;
+	pool * pool;			// resources of the worker thread
+	event * run;			// in the worker loop, computes the stages
+	list queue;			// stages to compute, protected by birdloop_enter()
+	list done;			// stages computed, protected by the lock
+	pthread_spinlock_t lock;
+	sock * notify_rs;
+	sock * notify_ws;
+} * sce_worker;
+
+/**
+ * Event of the worker loop.
+ * Computes a chunk of the first queued stage and hands it over to the main loop, if it is done.
+ */
+static void sce_worker_run(void * data) {
+	struct sce_worker * w = data;
+
+	if (EMPTY_LIST(w->queue)) return;
+
+	sce_scratch_init(w->pool);
+
+	struct sce_stage * stg = SKIP_BACK(struct sce_stage, wn, HEAD(w->queue));
+
+	if (stg->cancelled || sce_stage_compute(stg, SCE_WORKER_CHUNK)) {
+		rem_node(&stg->wn);
+
+		pthread_spin_lock(&w->lock);
+		add_tail(&w->done, &stg->wn);
+		pthread_spin_unlock(&w->lock);
+
+		pipe_kick(w->notify_ws->fd);
+	}
+
+	if (!EMPTY_LIST(w->queue))
+		ev2_schedule(w->run);
+}
+
+/**
+ * Called in the main loop when the worker has computed stages.
+ */
+static int sce_worker_notify(sock * sk, uint len UNUSED) {
+	struct sce_worker * w = sk->data;
+	list tmp_list;
+
+	pipe_drain(sk->fd);
+
+	pthread_spin_lock(&w->lock);
+	init_list(&tmp_list);
+	add_tail_list(&tmp_list, &w->done);
+	init_list(&w->done);
+	pthread_spin_unlock(&w->lock);
+
+	node * n, * nxt;
+	WALK_LIST_DELSAFE(n, nxt, tmp_list)
+		sce_stage_done(SKIP_BACK(struct sce_stage, wn, n));
+
+	return 0;
+}
+
+static void sce_worker_err(sock * sk UNUSED, int err) {
+	log(L_ERR "SCE: Notify socket error: %m", err);
+}
+
+static sock * sce_worker_sock(int fd, struct sce_worker * w) {
+	sock * sk = sk_new(&root_pool);
+	sk->type = SK_MAGIC;
+	sk->fd = fd;
+	sk->data = w;
+
+	if (sk_open(sk) < 0)
+		die("SCE: sk_open failed");
+
+	return sk;
+}
+
+/**
+ * Returns the worker thread, it is started on the first use.
+ */
+static struct sce_worker * sce_worker_get(void) {
+	if (sce_worker) return sce_worker;
+
+	struct sce_worker * w = sce_worker = xmalloc(sizeof(struct sce_worker));
+	w->loop = birdloop_new();
+	w->pool = rp_new(NULL, "SCE worker");
+	w->run = ev_new_init(w->pool, sce_worker_run, w);
+	init_list(&w->queue);
+	init_list(&w->done);
+	pthread_spin_init(&w->lock, PTHREAD_PROCESS_PRIVATE);
+
+	int pfds[2];
+	if (pipe(pfds) < 0)
+		die("pipe: %m");
+
+	w->notify_rs = sce_worker_sock(pfds[0], w);
+	w->notify_rs->rx_hook = sce_worker_notify;
+	w->notify_rs->err_hook = sce_worker_err;
+
+	// the write sock is not added to any event loop
+	w->notify_ws = sce_worker_sock(pfds[1], w);
+	w->notify_ws->flags = SKF_THREAD;
+
+	birdloop_start(w->loop);
+
+	return w;
+}
+
+/**
+ * Hands the stage @stg over to the worker thread.
+ * Returns 0, if there is no worker thread and the stage has to be computed by the caller.
+ *
+ * @stg: the stage with its snapshot
+ */
+_Bool sce_worker_queue(struct sce_stage * stg) {
+	struct sce_worker * w = sce_worker_get();
+
+	birdloop_enter(w->loop);
+	add_tail(&w->queue, &stg->wn);
+	ev2_schedule(w->run);
+	birdloop_leave(w->loop);
+
+	return 1;
+}
+
+static void sce_worker_cancel(struct sce_stage * stg) {
+	struct sce_worker * w = sce_worker_get();
+
+	birdloop_enter(w->loop);
+	stg->cancelled = 1;
+	birdloop_leave(w->loop);
+}
+
+/**
+ * Waits until the worker has computed all queued stages and completes them.
+ * The main loop does not need it, it is notified by the worker.
+ */
+void sce_worker_sync(void) {
+	struct sce_worker * w = sce_worker;
+	if (!w) return;
+
+	for (;;) {
+		birdloop_enter(w->loop);
+		_Bool empty = EMPTY_LIST(w->queue);
+		birdloop_leave(w->loop);
+
+		if (empty) break;
+
+		usleep(1000);
+	}
+
+	sce_worker_notify(w->notify_rs, 0);
+}
+
+#else
+
+void sce_worker_sync(void) { }
+
+_Bool sce_worker_queue(struct sce_stage * stg UNUSED) {
+	return 0;
+}
+
+static void sce_worker_cancel(struct sce_stage * stg UNUSED) {
+	bug("SCE: Stage busy without a worker");
+}
+
+#endif
+
+/*
+ * Contact graph
+ */
+
+/**
+ * Returns the current time in milliseconds since 01.01.2000 (UTC).
+ */
+static u64 sce_now(void) {
+	return (u64) (current_real_time() TO_MS) - DTNEPOCH;
+}
+
+#define SCECG_KEY(a)		a->asn
+#define SCECG_NEXT(a)		a->next
+#define SCECG_EQ(a,b)		a == b
+#define SCECG_FN(a)		u32_hash(a)
+
+#define SCECG_REHASH		sce_cg_as_rehash
+#define SCECG_PARAMS		/8, *2, 2, 2, 6, 20
+
+HASH_DEFINE_REHASH_FN(SCECG, struct sce_cg_as)
+
+#define SCECR_KEY(r)		r->dest
+#define SCECR_NEXT(r)		r->next
+#define SCECR_EQ(a,b)		a == b
+#define SCECR_FN(a)		u32_hash(a)
+
+#define SCECR_REHASH		sce_cg_route_rehash
+#define SCECR_PARAMS		/8, *2, 2, 2, 6, 20
+
+HASH_DEFINE_REHASH_FN(SCECR, struct sce_cg_route)
+
+#define SCE_CG_LESS(a,b)	((a)->arrival < (b)->arrival)
+#define SCE_CG_SWAP(heap,a,b,t)	(t = heap[a], heap[a] = heap[b], heap[b] = t, \
+				   heap[a]->index = (a), heap[b]->index = (b))
+
+static inline u64 sce_end_time(const scheduled_contact_entry * e) {
+	return e->start_time + e->duration;
+}
+
+static struct sce_cg_as * sce_cg_as_get(struct sce_cg * cg, u32 asn) {
+	struct sce_cg_as * a = HASH_FIND(cg->ases, SCECG, asn);
+
+	if (!a) {
+		a = sl_allocz(cg->as_slab);
+		a->asn = asn;
+		BUFFER_INIT(a->contacts, cg->pool, 4);
+		HASH_INSERT2(cg->ases, SCECG, cg->pool, a);
+	}
+
+	return a;
+}
+
+/**
+ * Rebuilds the vertices and edges of the graph from the plan.
+ *
+ * @cg: the contact graph
+ * @st: the sce store
+ */
+static void sce_cg_build(struct sce_cg * cg, struct sce_store * st) {
+	HASH_WALK_DELSAFE(cg->ases, next, a) {
+		mb_free(a->contacts.data);
+		sl_free(cg->as_slab, a);
+	}
+	HASH_WALK_DELSAFE_END;
+
+	HASH_FREE(cg->ases);
+	HASH_INIT(cg->ases, cg->pool, 6);
+
+	struct sce_node * n;
+	WALK_LIST(n, st->set.list) {
+		if (n->e.asn1 == n->e.asn2) continue;
+
+		BUFFER_PUSH(sce_cg_as_get(cg, n->e.asn1)->contacts) = n;
+		BUFFER_PUSH(sce_cg_as_get(cg, n->e.asn2)->contacts) = n;
+	}
+
+	cg->version = st->version;
+}
+
+/**
+ * Earliest-arrival search from the local AS, starting at @cg->now.
+ * A contact can be used from an AS, if it did not end before the arrival at the AS.
+ * The other AS of the contact is reached when the contact begins, but not before
+ * the arrival at the first AS.
+ *
+ * @cg: the contact graph
+ */
+static void sce_cg_search(struct sce_cg * cg) {
+	HASH_WALK(cg->ases, next, a) {
+		a->arrival = SCE_CG_NEVER;
+		a->prev = NULL;
+		a->via = NULL;
+		a->index = 0;
+		a->done = 0;
+	}
+	HASH_WALK_END;
+
+	cg->searched = 1;
+
+	struct sce_cg_as * src = HASH_FIND(cg->ases, SCECG, cg->own);
+	if (!src) return;
+
+	cg->heap.used = 1;
+	src->arrival = cg->now;
+	src->index = cg->heap.used;
+	BUFFER_PUSH(cg->heap) = src;
+
+	while (cg->heap.used > 1) {
+		struct sce_cg_as * u = cg->heap.data[1];
+		uint num = cg->heap.used - 1;
+
+		HEAP_DELMIN(cg->heap.data, num, struct sce_cg_as *, SCE_CG_LESS, SCE_CG_SWAP);
+		BUFFER_POP(cg->heap);
+		u->index = 0;
+		u->done = 1;
+
+		for (uint i = 0; i < u->contacts.used; i++) {
+			struct sce_node * c = u->contacts.data[i];
+
+			if (sce_end_time(&c->e) <= u->arrival) continue;
+
+			u64 t = MAX(u->arrival, c->e.start_time);
+			struct sce_cg_as * v = HASH_FIND(cg->ases, SCECG, (c->e.asn1 == u->asn) ? c->e.asn2 : c->e.asn1);
+
+			if (v->done || (t >= v->arrival)) continue;
+
+			v->arrival = t;
+			v->prev = u;
+			v->via = c;
+
+			if (v->index) {
+				num = cg->heap.used - 1;
+				HEAP_DECREASE(cg->heap.data, num, struct sce_cg_as *, SCE_CG_LESS, SCE_CG_SWAP, v->index);
+			}
+			else {
+				v->index = cg->heap.used;
+				BUFFER_PUSH(cg->heap) = v;
+				num = cg->heap.used - 1;
+				HEAP_INSERT(cg->heap.data, num, struct sce_cg_as *, SCE_CG_LESS, SCE_CG_SWAP);
+			}
+		}
+	}
+}
+
+/**
+ * Returns the contact graph of the plan with the earliest arrivals from AS @own.
+ * The graph is rebuilt when the plan changed and searched again when a contact
+ * began or ended since the last search. Otherwise the cached paths are kept.
+ *
+ * @st: the sce store
+ * @own: the local ASN
+ * @now: the current time in milliseconds since 01.01.2000 (UTC)
+ */
+struct sce_cg * sce_cg_get(struct sce_store * st, u32 own, u64 now) {
+	struct sce_cg * cg = st->cg;
+
+	if (!cg) {
+		pool * p = rp_new(st->pool, "SCE contact graph");
+		cg = st->cg = mb_allocz(p, sizeof(struct sce_cg));
+		cg->pool = p;
+		cg->lp = lp_new_default(p);
+		cg->as_slab = sl_new(p, sizeof(struct sce_cg_as));
+		HASH_INIT(cg->ases, p, 6);
+		HASH_INIT(cg->routes, p, 6);
+		BUFFER_INIT(cg->heap, p, 16);
+		BUFFER_PUSH(cg->heap) = NULL;
+		cg->version = st->version - 1;
+	}
+
+	_Bool rebuild = (cg->version != st->version);
+
+	if (rebuild)
+		sce_cg_build(cg, st);
+
+	if (rebuild || !cg->searched || (cg->fired != st->sched.fired) || (cg->own != own)) {
+		HASH_FREE(cg->routes);
+		HASH_INIT(cg->routes, cg->pool, 6);
+		lp_flush(cg->lp);
+
+		cg->own = own;
+		cg->fired = st->sched.fired;
+		cg->now = now;
+		sce_cg_search(cg);
+	}
+
+	return cg;
+}
+
+/**
+ * Returns the path with the earliest arrival from the local AS to AS @dest,
+ * or NULL if @dest can not be reached over the contacts of the plan.
+ * The path is valid until the next call of sce_cg_get().
+ *
+ * @cg: the contact graph
+ * @dest: the destination ASN
+ */
+struct sce_cg_route * sce_cg_route_get(struct sce_cg * cg, u32 dest) {
+	struct sce_cg_route * r = HASH_FIND(cg->routes, SCECR, dest);
+	if (r) return r;
+
+	struct sce_cg_as * a = HASH_FIND(cg->ases, SCECG, dest);
+	if (!a || (a->arrival == SCE_CG_NEVER) || (dest == cg->own)) return NULL;
+
+	uint len = 1;
+	for (struct sce_cg_as * x = a; x->prev; x = x->prev)
+		len++;
+
+	r = lp_allocz(cg->lp, sizeof(struct sce_cg_route) + len * sizeof(u32));
+	r->dest = dest;
+	r->arrival = a->arrival;
+	r->len = len;
+	r->hops = lp_alloc(cg->lp, (len - 1) * sizeof(struct sce_node *));
+
+	for (struct sce_cg_as * x = a; x; x = x->prev) {
+		r->asns[--len] = x->asn;
+		if (x->via) r->hops[len - 1] = x->via;
+	}
+
+	HASH_INSERT2(cg->routes, SCECR, cg->pool, r);
+	return r;
+}
+
+/**
+ * Returns 1 if all contacts of the path @r are open at @now.
+ */
+_Bool sce_cg_route_open(struct sce_cg_route * r, u64 now) {
+	for (uint i = 0; i < r->len - 1; i++)
+		if ((r->hops[i]->e.start_time > now) || (sce_end_time(&r->hops[i]->e) <= now))
+			return 0;
+
+	return 1;
+}
+
+/*
+ * Writes the route of network @n with the AS path @path, that was added or
+ * withdrawn by a contact, to the MRT dump, if protocol @p records its contacts.
+ *
+ * @p: the bgp protocol of the contact
+ * @subtype: MRT_SCE_ROUTE_ADD or MRT_SCE_ROUTE_WITHDRAW
+ * @n: the network
+ * @path: the AS path of the route
+ */
+static void sce_mrt_route(struct bgp_proto * p, uint subtype, net * n, const struct adata * path) {
+	if (!p || !(p->p.mrtdump & MD_CONTACTS)) return;
+
+	struct mrt_sce_data d = {
+		.local_as = p->public_as,
+		.peer_as = p->remote_as,
+		.subtype = subtype,
+		.net = n->n.addr,
+		.path = path,
+	};
+
+	mrt_dump_sce_route(&d);
+}
+
+/*
+ * Announces the new route @new_rte of network @n, if it is not known yet.
+ * Returns 1, if the route was announced.
+ *
+ * @chl: the channel of the table
+ * @p: the bgp protocol of the contact
+ * @n: the network
+ * @new_rte: the new route, it is freed if it is not unique
+ */
+static _Bool sce_announce(struct channel * chl, struct bgp_proto * p, net * n, rte * new_rte) {
+	if (!is_unique_route(new_rte, n)) {
+		// if the route was not unique, we can delete it
+		rte_free(new_rte);
+		return 0;
+	}
+
+	// the route is kept next to the routes it was derived from and it is not sent to the peers,
+	// it does not belong to the Adj-RIB-In either
+	new_rte->flags |= REF_LOCAL;
+	sce_mrt_route(p, MRT_SCE_ROUTE_ADD, n, get_as_path_attr(new_rte)->u.ptr);
+	rte_update2(chl, n->n.addr, new_rte, chl->proto->main_source);
+	return 1;
+}
+
+static entry_data * sce_cg_route_uses(struct sce_cg_route * r, entry_data ** eds, uint count) {
+	for (uint i = 0; i < r->len - 1; i++)
+		for (uint k = 0; k < count; k++)
+			if (&r->hops[i]->e == eds[k]->sce) return eds[k];
+
+	return NULL;
+}
+
+static _Bool sce_cg_route_contains(struct sce_cg_route * r, u32 asn) {
+	for (uint i = 0; i < r->len; i++)
+		if (r->asns[i] == asn) return 1;
+
+	return 0;
+}
+
+/**
+ * Adds the routes over chains of contacts, that are open now and contain one of the contacts @eds.
+ * For every AS reached over such a chain, the routes of the networks behind
+ * this AS are prefixed with the chain.
+ *
+ * @eds: entry_data of the contacts that began, all of the same channel
+ * @count: number of the contacts
+ * @idx: the AS pair index of the table
+ */
+static void modify_routingtable_add_chains(entry_data **eds, uint count, struct sce_index *idx) {
+	struct bgp_proto * proto = eds[0]->proto;
+	struct channel * chl = eds[0]->ch;
+	u32 mypublicasn = proto->public_as;
+	u64 now = sce_now();
+
+	struct sce_cg * cg = sce_cg_get(sce_store_get(), mypublicasn, now);
+
+	HASH_WALK(cg->ases, next, a) {
+		struct sce_cg_route * r = sce_cg_route_get(cg, a->asn);
+
+		// paths over a single contact are found by insert_sce_in_path()
+		entry_data * ed = r ? sce_cg_route_uses(r, eds, count) : NULL;
+		if (!ed || (r->len < 3) || !sce_cg_route_open(r, now))
+			continue;
+
+		// the route is valid until the first of its contacts ends
+		u64 end = sce_end_time(&r->hops[0]->e);
+		for (uint i = 1; i < r->len - 1; i++)
+			end = MIN(end, sce_end_time(&r->hops[i]->e));
+
+		net ** nets;
+		uint num_nets = sce_index_as_nets(idx, r->dest, &nets);
+
+		for (uint k = 0; k < num_nets; k++) {
+			net * n = nets[k];
+
+			// only the routes that existed before the contact are used as templates
+			rte * last = NULL;
+			for (rte * rt = n->routes; rt; rt = rt->next)
+				last = rt;
+
+			rte * oldroute = n->routes;
+			rte * next;
+			for (; oldroute; oldroute = next) {
+				next = (oldroute == last) ? NULL : oldroute->next;
+				struct eattr * as_path_attr = get_as_path_attr(oldroute);
+				if (!as_path_attr) continue;
+
+				struct as_path_iter it;
+				as_path_iter_init(&it, as_path_attr->u.ptr);
+
+				_Bool found = 0;
+				u32 as;
+				while (!found && as_path_iter_next(&it, &as))
+					found = (as == r->dest) && !as_path_iter_in_set(&it);
+
+				if (!found) continue;
+
+				// the tail behind the destination must not loop back into the chain
+				_Bool loop = 0;
+				struct as_path_iter tail = it;
+				while (!loop && as_path_iter_next(&tail, &as))
+					loop = sce_cg_route_contains(r, as);
+
+				if (loop) continue;
+
+				eattr * new_attr = sce_path_join(r->asns, r->len, it);
+				if (!new_attr) continue;
+
+				rte * new_rte = sce_route_copy(&oldroute, new_attr, proto, &r->hops[0]->e, end);
+
+				if (sce_announce(chl, proto, n, new_rte) && ed->stats)
+					ed->stats->added++;
+			}
+		}
+
+		mb_free(nets);
+	}
+	HASH_WALK_END;
+}
+
+/*
+ * Commits the routes of network @n prepared in the stage of contact @ed.
+ * The templates are looked up among the routes up to @last by their attributes.
+ */
+static void sce_stage_commit(struct sce_stage_net * sn, net * n, rte * last, entry_data * ed) {
+	for (struct sce_stage_route * sr = sn->routes; sr; sr = sr->next) {
+		rte * tmpl = NULL;
+		for (rte * r = n->routes; r && !tmpl; r = (r == last) ? NULL : r->next)
+			if (r->attrs == sr->tmpl)
+				tmpl = r;
+
+		if (!tmpl) continue;
+
+		rte * new_rte = copy_rte_and_insert_as_path(&tmpl, &sr->attr, ed->proto, ed->sce);
+
+		if (sce_announce(ed->ch, ed->proto, n, new_rte) && ed->stats)
+			ed->stats->added++;
+	}
+}
+
+/*
+ * Is called after scheduled contacts begin.
+ * Traverses the affected routes and adds the AS-AS pairs from the scheduled contact entries.
+ * Here we want to find new routes that becomme possible due to the contacts.
+ * The affected networks of all contacts are collected first, so every network is visited once.
+ * The routes prepared in the look-ahead window are committed directly,
+ * only the networks that changed since then are computed again.
+ *
+ * @eds: entry_data structs that contain various informations needed for this process,
+ *       all of them with the same channel
+ * @count: number of the contacts
+ */
+void modify_routingtable_add(entry_data **eds, uint count) {
+
+	// get table and check if exists
+	struct channel * chl = eds[0]->ch;
+	struct rtable *table;
+
+	if (chl) table = chl->table;
+	else return;
+
+	if ( !(table) ) return;
+
+	// e.g. the plan was queued at startup, the routes are built by sce_store_reopen()
+	if (chl->channel_state != CS_UP) return;
+
+	struct bgp_proto * proto = eds[0]->proto;
+	u32 mypublicasn = proto->public_as;
+
+	/*
+	 * A new path can only be found in a network that has a route with the
+	 * other ASN of the contact, the own ASN is part of every path.
+	 */
+	struct sce_index * idx = sce_index_get(table);
+	BUFFER_(net *) all;
+	BUFFER_INIT(all, idx->pool, 16);
+
+	for (uint i = 0; i < count; i++) {
+		struct sce_stage * stg = eds[i]->stage;
+
+		if (stg && (stg->idx == idx)) {
+			// the own updates below must not mark the networks of the stage dirty
+			if (stg->n.next)
+				rem_node(&stg->n);
+
+			HASH_WALK(stg->nets, next, sn)
+				BUFFER_PUSH(all) = sn->net;
+			HASH_WALK_END;
+
+			continue;
+		}
+
+		scheduled_contact_entry * entry = eds[i]->sce;
+		u32 search_asn = (entry->asn1 == mypublicasn) ? entry->asn2 : entry->asn1;
+
+		net ** nets;
+		uint num = sce_index_as_nets(idx, search_asn, &nets);
+		for (uint k = 0; k < num; k++)
+			BUFFER_PUSH(all) = nets[k];
+
+		mb_free(nets);
+	}
+
+	net ** nets = all.data;
+	uint num_nets = sce_nets_unique(all.data, all.used);
+
+	for (uint k = 0; k < num_nets; k++) {
+		net * n = nets[k];
+
+		// only the routes that existed before the contacts are used as templates
+		rte * last = NULL;
+		for (rte * r = n->routes; r; r = r->next)
+			last = r;
+
+		if (!last) continue;
+
+		uint num_paths;
+		const struct adata ** paths = sce_route_paths(n->routes, &num_paths);
+
+		for (uint c = 0; c < count; c++) {
+			scheduled_contact_entry * entry = eds[c]->sce;
+			struct sce_stage * stg = eds[c]->stage;
+
+			if (stg && (stg->idx == idx)) {
+				struct sce_stage_net * sn = HASH_FIND(stg->nets, SCESN, n);
+
+				if (!sn) continue;
+
+				if (!sn->dirty) {
+					sce_stage_commit(sn, n, last, eds[c]);
+					continue;
+				}
+			}
+
+			rte * oldroute = n->routes;
+			rte * next;
+			for (; oldroute; oldroute = next) {
+				next = (oldroute == last) ? NULL : oldroute->next;
+				struct eattr * as_path_attr = get_as_path_attr(oldroute);
+
+				if (!as_path_attr) continue;
+
+				attrs_holding * new_as_path_attr = sce_insert_pair(entry, as_path_attr->u.ptr, paths, num_paths, mypublicasn);
+
+				if (!new_as_path_attr) continue;
+
+				for (int i = 0; i < new_as_path_attr->num_of_new; i++) {
+					eattr * tmp_attr = new_as_path_attr->attrs+i;
+					rte * new_rte = copy_rte_and_insert_as_path(&oldroute, tmp_attr, proto, entry);
+
+					if (sce_announce(chl, proto, n, new_rte) && eds[c]->stats)
+						eds[c]->stats->added++;
+				}
+			}
+		}
+	}
+
+	mb_free(nets);
+
+	// paths that need these and further open contacts
+	modify_routingtable_add_chains(eds, count, idx);
+}
+
+
+/*
+ * Checks if a path contains the AS-AS pair and if so it returns 1,
+ * indicating that we should remove this route, when a contact ends.
+ *
+ * @entry: the scheduled_contact_entry containing the AS-AS pair
+ * @as_path_attr: the AS_PATH attribute
+ * @mypublicasn: the own ASN
+ */
+
+_Bool path_contains_as_pair(scheduled_contact_entry * entry, eattr * as_path_attr, u32 mypublicasn) {
+	u32 asn1 = entry->asn1;
+	u32 asn2 = entry->asn2;
+
+	struct as_path_iter it;
+	as_path_iter_init(&it, as_path_attr->u.ptr);
+
+	// the path starts with the own ASN, an AS_SET is not adjacent to anything
+	u32 prev = mypublicasn, as;
+	_Bool adjacent = 1;
+
+	while (as_path_iter_next(&it, &as)) {
+		if (as_path_iter_in_set(&it)) {
+			adjacent = 0;
+			continue;
+		}
+
+		if (adjacent && (( prev == asn1 && as == asn2 ) || ( prev == asn2 && as == asn1 ))) return 1;
+
+		prev = as;
+		adjacent = 1;
+	}
+
+	return 0;
+}
+
+/**
+ * Is called after scheduled contacts end.
+ * Traverses the affected routes and checks which route contains an AS-AS pair from the sces.
+ * If a route contains a pair, it is removed by rte_remove_local().
+ * Every affected network is visited once, even if it contains pairs of several contacts.
+ * Contacts, whose AS pair stays connected by another open contact of the plan,
+ * do not withdraw anything, as their routes would only be computed again.
+ *
+ * @eds: entry_data structs that contain various informations needed for this process,
+ *       all of them with the same channel
+ * @count: number of the contacts
+ */
+void modify_routingtable_remove(entry_data **eds, uint count) {
+	// get table and chek if exists
+	struct channel * chl = eds[0]->ch;
+	struct rtable *table;
+
+	if (chl) table = chl->table;
+	else return;
+
+	if ( !(table) ) return;
+
+	struct bgp_proto * proto = eds[0]->proto;
+	u32 mypublicasn = proto->public_as;
+
+	// overlapping windows of the same AS pair, e.g. from different plan sources
+	struct sce_store * st = sce_store_get();
+	entry_data ** ends = sce_alloc(count * sizeof(entry_data *));
+	uint num_ends = 0;
+
+	for (uint i = 0; i < count; i++)
+		if (!sce_store_pair_open(st, eds[i]->sce, sce_end_time(eds[i]->sce)))
+			ends[num_ends++] = eds[i];
+
+	if (!num_ends) return;
+
+	eds = ends;
+	count = num_ends;
+
+	// only networks that have a route containing the AS-AS pair are affected,
+	// if the own ASN is part of the pair, these are the routes starting with the other ASN
+	struct sce_index * idx = sce_index_get(table);
+	BUFFER_(net *) all;
+	BUFFER_INIT(all, idx->pool, 16);
+
+	for (uint i = 0; i < count; i++) {
+		scheduled_contact_entry * entry = eds[i]->sce;
+		u32 asn1 = (entry->asn1 == mypublicasn) ? SCE_PAIR_START : entry->asn1;
+		u32 asn2 = (entry->asn2 == mypublicasn) ? SCE_PAIR_START : entry->asn2;
+
+		net ** nets;
+		uint num = sce_index_pair_nets(idx, asn1, asn2, &nets);
+		for (uint k = 0; k < num; k++)
+			BUFFER_PUSH(all) = nets[k];
+
+		mb_free(nets);
+	}
+
+	net ** nets = all.data;
+	uint num_nets = sce_nets_unique(all.data, all.used);
+
+	for (uint k = 0; k < num_nets; k++) {
+		net * n = nets[k];
+
+		rte * oldroute;
+		rte * next;
+
+		for (oldroute = n->routes; oldroute; oldroute = next) {
+			next = oldroute->next;
+			struct eattr * as_path_attr = get_as_path_attr(oldroute);
+
+			if (!as_path_attr) continue;
+
+			entry_data * routewithdraw = NULL;
+			for (uint c = 0; !routewithdraw && (c < count); c++)
+				if (path_contains_as_pair(eds[c]->sce, as_path_attr, mypublicasn))
+					routewithdraw = eds[c];
+
+			// the route contains an AS-AS pair so we remove this route
+			if (routewithdraw) {
+				if (routewithdraw->stats)
+					routewithdraw->stats->withdrawn++;
+
+				sce_mrt_route(proto, MRT_SCE_ROUTE_WITHDRAW, n, as_path_attr->u.ptr);
+				rte_remove_local(oldroute);
+
+				// the new best route may have been moved to the front
+				next = n->routes;
+			}
+		}
+	}
+
+	mb_free(nets);
+}
+
+/*
+ * Contact plan scheduler
+ */
+
+#define SCE_EV_LESS(a,b)	((a)->when < (b)->when)
+#define SCE_EV_SWAP(heap,a,b,t)	(t = heap[a], heap[a] = heap[b], heap[b] = t, \
+				   heap[a]->index = (a), heap[b]->index = (b))
+
+static void sce_sched_fire(timer *t);
+static void sce_sched_clock(timer *t);
+static void sce_sched_prepare(void *data);
+
+static inline u64 sce_lookahead(void) {
+	return (config ? config->sce_lookahead : SCE_LOOKAHEAD_DEFAULT) TO_MS;
+}
+
+/**
+ * Initializes an empty scheduler.
+ *
+ * @s: the scheduler
+ * @p: the pool for the events and the timer
+ */
+void sce_sched_init(struct sce_sched * s, pool * p) {
+	s->pool = p;
+	s->slab = sl_new(p, sizeof(struct sce_event));
+	s->timer = tm_new_init(p, sce_sched_fire, s, 0, 0);
+	s->clock = tm_new_init(p, sce_sched_clock, s, SCE_CLOCK_CHECK, 0);
+	BUFFER_INIT(s->heap, p, 64);
+	BUFFER_PUSH(s->heap) = NULL;
+	BUFFER_INIT(s->due, p, 16);
+	BUFFER_INIT(s->pending, p, 16);
+	s->prepare = ev_new_init(p, sce_sched_prepare, s);
+}
+
+/**
+ * Sets the timer to the earliest queued event.
+ * The contact times are real time, but timers run on the monotonic clock,
+ * so the event is anchored by the current offset of both clocks.
+ * The offset is remembered to notice when the real-time clock is stepped.
+ *
+ * @s: the scheduler
+ */
+static void sce_sched_arm(struct sce_sched * s) {
+	struct sce_event * ev = sce_sched_first(s);
+
+	if (!ev) {
+		tm_stop(s->timer);
+		tm_stop(s->clock);
+		return;
+	}
+
+	btime now = current_time();
+	s->offset = current_real_time() - now;
+
+	btime when = (btime) (ev->when + DTNEPOCH) MS_ - s->offset;
+	tm_set(s->timer, MAX(when, now));
+
+	if (!tm_active(s->clock))
+		tm_start(s->clock, SCE_CLOCK_CHECK);
+}
+
+/**
+ * Called periodically by the clock timer of the scheduler while events are queued.
+ * If the real-time clock was stepped, e.g. by NTP or by hand, the timer is
+ * re-anchored, so the contacts still begin and end at their real time.
+ *
+ * @t: the clock timer of the scheduler
+ */
+static void sce_sched_clock(timer *t) {
+	struct sce_sched * s = t->data;
+	btime step = (current_real_time() - current_time()) - s->offset;
+
+	if ((step > -SCE_CLOCK_STEP) && (step < SCE_CLOCK_STEP))
+		return;
+
+	log(L_WARN "Real-time clock stepped by %t s, rescheduling %u contact events",
+			step, s->heap.used - 1);
+
+	s->steps++;
+	sce_sched_arm(s);
+}
+
+static void sce_sched_remove(struct sce_sched * s, struct sce_event * ev) {
+	uint num = s->heap.used - 1;
+
+	HEAP_DELETE(s->heap.data, num, struct sce_event *, SCE_EV_LESS, SCE_EV_SWAP, ev->index);
+	BUFFER_POP(s->heap);
+	ev->index = -1;
+}
+
+static struct sce_event * sce_sched_new_event(struct sce_sched * s, struct sce_node * n, u8 type,
+		struct channel * c, struct bgp_proto * proto) {
+	struct sce_event * ev = sl_alloc(s->slab);
+
+	if (type == SCE_EV_PREPARE)
+		ev->when = n->e.start_time - MIN(sce_lookahead(), n->e.start_time);
+	else
+		ev->when = n->e.start_time + ((type == SCE_EV_END) ? n->e.duration : 0);
+
+	ev->type = type;
+	ev->node = n;
+	ev->ed = (entry_data) { .sce = &n->e, .ch = c, .proto = proto, .stats = &n->stats };
+
+	n->events[type] = ev;
+
+	ev->index = s->heap.used;
+	BUFFER_PUSH(s->heap) = ev;
+
+	return ev;
+}
+
+/*
+ * Queues the events of the contacts @nodes, see sce_sched_add_sces().
+ * If @begun is not set, the begin of contacts that already began is not queued.
+ */
+static void sce_sched_add(struct sce_sched * s, struct sce_node ** nodes, uint count,
+		struct channel * c, struct bgp_proto * proto, _Bool begun) {
+	if (!count) return;
+
+	uint old = s->heap.used - 1;
+	_Bool rebuild = (2 * count) > old;
+	u64 now = sce_now();
+	_Bool lookahead = sce_lookahead() > 0;
+
+	for (uint i = 0; i < count; i++) {
+		// a contact that is already over is not run at all
+		if (sce_end_time(&nodes[i]->e) <= now) continue;
+
+		_Bool future = nodes[i]->e.start_time > now;
+
+		for (u8 type = SCE_EV_BEGIN; type < SCE_EV_MAX; type++) {
+			if ((type == SCE_EV_PREPARE) && (!lookahead || !future))
+				continue;
+
+			if ((type == SCE_EV_BEGIN) && !begun && !future)
+				continue;
+
+			sce_sched_new_event(s, nodes[i], type, c, proto);
+
+			if (!rebuild) {
+				uint num = s->heap.used - 1;
+				HEAP_INSERT(s->heap.data, num, struct sce_event *, SCE_EV_LESS, SCE_EV_SWAP);
+			}
+		}
+	}
+
+	if (rebuild) {
+		uint num = s->heap.used - 1;
+		HEAP_INIT(s->heap.data, num, struct sce_event *, SCE_EV_LESS, SCE_EV_SWAP);
+	}
+
+	sce_sched_arm(s);
+}
+
+/**
+ * Queues the begin and the end of the contacts @nodes and the begin of their
+ * look-ahead window, if the contact did not begin yet.
+ * A large plan is added at once and the heap is rebuilt in linear time.
+ *
+ * @s: the scheduler
+ * @nodes: the sces, they must stay in the store until they are cancelled
+ * @count: number of the sces
+ * @c: the used channel
+ * @proto: the bgp_proto struct
+ */
+void sce_sched_add_sces(struct sce_sched * s, struct sce_node ** nodes, uint count,
+		struct channel * c, struct bgp_proto * proto) {
+	sce_sched_add(s, nodes, count, c, proto, 1);
+}
+
+/**
+ * Removes the queued events and the prepared routes of a sce, e.g. when it is replaced or deleted.
+ *
+ * @s: the scheduler
+ * @n: the sce
+ */
+void sce_sched_cancel(struct sce_sched * s, struct sce_node * n) {
+	_Bool first = 0;
+
+	for (uint i = 0; i < s->pending.used; i++)
+		if (s->pending.data[i] == n)
+			s->pending.data[i] = NULL;
+
+	sce_stage_free(n->stage);
+	n->stage = NULL;
+
+	for (u8 type = SCE_EV_BEGIN; type < SCE_EV_MAX; type++) {
+		struct sce_event * ev = n->events[type];
+		if (!ev) continue;
+
+		first |= (ev == sce_sched_first(s));
+		sce_sched_remove(s, ev);
+		sl_free(s->slab, ev);
+		n->events[type] = NULL;
+	}
+
+	if (first)
+		sce_sched_arm(s);
+}
+
+static int sce_event_cmp(const void * a, const void * b) {
+	const struct sce_event * x = *(const struct sce_event **) a;
+	const struct sce_event * y = *(const struct sce_event **) b;
+
+	// ends first, so no new routes are derived from routes of ended contacts
+	if (x->type != y->type)
+		return (x->type == SCE_EV_END) ? -1 : 1;
+
+	if (x->ed.ch != y->ed.ch)
+		return ((uintptr_t) x->ed.ch < (uintptr_t) y->ed.ch) ? -1 : 1;
+
+	if (x->ed.proto != y->ed.proto)
+		return ((uintptr_t) x->ed.proto < (uintptr_t) y->ed.proto) ? -1 : 1;
+
+	return 0;
+}
+
+/**
+ * Returns the time of the monotonic clock. Unlike current_time(),
+ * it is not cached for the iteration of the main loop.
+ */
+static btime sce_clock(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec S + ts.tv_nsec NS;
+}
+
+static void sce_hist_add(struct sce_hist * h, btime t) {
+	uint b = 0;
+	for (btime limit = 100; (t >= limit) && (b < SCE_HIST_BUCKETS - 1); limit *= 10)
+		b++;
+
+	h->count++;
+	h->total += t;
+	h->max = MAX(h->max, t);
+	h->buckets[b]++;
+}
+
+/**
+ * Runs the due events @evs as batches. All events of the same type and
+ * channel are handed over at once, so the table is only traversed once per batch.
+ * The duration of every batch is recorded for each of its contacts.
+ *
+ * @s: the scheduler
+ * @evs: the events
+ * @count: number of the events
+ * @now: the time the events fired at
+ */
+static void sce_sched_run(struct sce_sched * s, struct sce_event ** evs, uint count, u64 now) {
+	qsort(evs, count, sizeof(struct sce_event *), sce_event_cmp);
+
+	entry_data ** eds = sce_alloc(count * sizeof(entry_data *));
+
+	for (uint i = 0; i < count; ) {
+		uint num = 0;
+		struct sce_event * first = evs[i];
+
+		while ((i < count) && !sce_event_cmp(&first, &evs[i])) {
+			// a stage still computed by the worker is not used
+			evs[i]->ed.stage = sce_stage_ready(evs[i]->node->stage) ? evs[i]->node->stage : NULL;
+			eds[num++] = &evs[i++]->ed;
+		}
+
+		btime start = sce_clock();
+
+		if (first->type == SCE_EV_BEGIN)
+			contact_begin(eds, num);
+		else
+			contact_end(eds, num);
+
+		btime duration = sce_clock() - start;
+		sce_hist_add((first->type == SCE_EV_BEGIN) ? &s->add_hist : &s->remove_hist, duration);
+
+		for (uint k = i - num; k < i; k++) {
+			struct sce_stats * stats = &evs[k]->node->stats;
+
+			if (evs[k]->type == SCE_EV_END) {
+				stats->remove_time = duration;
+				continue;
+			}
+
+			stats->add_time = duration;
+			stats->latency = ((now > evs[k]->when) ? (btime) (now - evs[k]->when) MS_ : 0) + duration;
+			sce_hist_add(&s->latency_hist, stats->latency);
+		}
+	}
+}
+
+/**
+ * Called by the timer of the scheduler.
+ * Runs all events that are due in one batch and sets the timer to the next one.
+ * The route updates of the batch share one rte_update_lock() window.
+ * Contacts entering their look-ahead window are handed over to the work event.
+ *
+ * @t: the timer of the scheduler
+ */
+static void sce_sched_fire(timer *t) {
+	struct sce_sched * s = t->data;
+	u64 now = sce_now();
+	struct sce_event * ev;
+
+	s->due.used = 0;
+
+	while ((ev = sce_sched_first(s)) && (ev->when <= now)) {
+		sce_sched_remove(s, ev);
+		ev->node->events[ev->type] = NULL;
+
+		if (ev->type == SCE_EV_PREPARE) {
+			BUFFER_PUSH(s->pending) = ev->node;
+			sl_free(s->slab, ev);
+			continue;
+		}
+
+		s->fired++;
+		BUFFER_PUSH(s->due) = ev;
+	}
+
+	if (s->pending.used)
+		ev_schedule_work(s->prepare);
+
+	rte_update_batch_lock();
+	sce_sched_run(s, s->due.data, s->due.used, now);
+	rte_update_batch_unlock();
+
+	sce_scratch_flush();
+
+	for (uint i = 0; i < s->due.used; i++) {
+		ev = s->due.data[i];
+
+		// the prepared routes are committed or outdated now
+		if (ev->type == SCE_EV_BEGIN) {
+			sce_stage_free(ev->node->stage);
+			ev->node->stage = NULL;
+		}
+
+		sl_free(s->slab, ev);
+	}
+
+	s->due.used = 0;
+	sce_sched_arm(s);
+}
+
+/**
+ * Work event of the scheduler.
+ * Prepares the routes of up to SCE_PREPARE_MAX pending contacts and schedules
+ * itself again, if more are left, so other events are not delayed.
+ *
+ * @data: the scheduler
+ */
+static void sce_sched_prepare(void *data) {
+	struct sce_sched * s = data;
+	uint done = 0;
+	uint i;
+
+	for (i = 0; (i < s->pending.used) && (done < SCE_PREPARE_MAX); i++) {
+		struct sce_node * n = s->pending.data[i];
+
+		// removed meanwhile or the contact already began
+		if (!n || n->stage || !n->events[SCE_EV_BEGIN])
+			continue;
+
+		n->stage = sce_stage_prepare(&n->events[SCE_EV_BEGIN]->ed);
+		s->prepared++;
+		done++;
+	}
+
+	s->pending.used -= i;
+	memmove(s->pending.data, s->pending.data + i, s->pending.used * sizeof(struct sce_node *));
+
+	sce_scratch_flush();
+
+	if (s->pending.used)
+		ev_schedule_work(s->prepare);
+}
+
+/*
+ * Writes the contacts @eds, that began or ended, to the MRT dump,
+ * if their protocol records its contacts ("mrtdump { contacts }").
+ * The route changes of the contacts follow in separate records.
+ *
+ * @eds: entry_data of the contacts, all of them with the same channel
+ * @count: number of the contacts
+ * @subtype: MRT_SCE_CONTACT_BEGIN or MRT_SCE_CONTACT_END
+ */
+static void sce_mrt_contacts(entry_data ** eds, uint count, uint subtype) {
+	struct bgp_proto * p = eds[0]->proto;
+	if (!p || !(p->p.mrtdump & MD_CONTACTS)) return;
+
+	const scheduled_contact_entry ** sces = sce_alloc(count * sizeof(scheduled_contact_entry *));
+	for (uint i = 0; i < count; i++)
+		sces[i] = eds[i]->sce;
+
+	struct mrt_sce_data d = {
+		.local_as = p->public_as,
+		.peer_as = p->remote_as,
+		.subtype = subtype,
+		.count = count,
+		.sces = sces,
+	};
+
+	mrt_dump_sce_contacts(&d);
+}
+
+/**
+ * Called by the scheduler when contacts begin.
+ * Invokes the path calculations.
+ *
+ * @eds: entry_data of the contacts, all of them with the same channel
+ * @count: number of the contacts
+ */
+void
+contact_begin(entry_data **eds, uint count) {
+	for (uint i = 0; i < count; i++)
+		log(L_INFO "\n ==> Begin of contact between AS%u and AS%u !", eds[i]->sce->asn1, eds[i]->sce->asn2);
+
+	sce_mrt_contacts(eds, count, MRT_SCE_CONTACT_BEGIN);
+	modify_routingtable_add(eds, count);
+}
+
+/**
+ * Called by the scheduler when contacts end.
+ * Invokes the path calculations.
+ *
+ * @eds: entry_data of the contacts, all of them with the same channel
+ * @count: number of the contacts
+ */
+void
+contact_end(entry_data **eds, uint count) {
+	for (uint i = 0; i < count; i++)
+		log(L_INFO "\n ==> End of contact between AS%u and AS%u !", eds[i]->sce->asn1, eds[i]->sce->asn2);
+
+	sce_mrt_contacts(eds, count, MRT_SCE_CONTACT_END);
+	modify_routingtable_remove(eds, count);
+}
+
+
+/*
+ * Handling, saving, registering scheduled contact entries
+ */
+
+/**
+ * Adds the new sces of @entries to the resident contact plan,
+ * schedules them and appends them to the journal in SCES_FILENAME.
+ *
+ * @entries: the scheduled contact entries
+ * @c: the used channel
+ * @proto: the bgp protocol
+ */
+void store_sces(scheduled_contact_entries *entries, struct channel *c, struct bgp_proto * proto) {
+
+	struct sce_store * st = sce_store_get();
+	struct sce_node ** added = mb_alloc(st->pool, sizeof(struct sce_node *) * MAX(entries->number_of_entries, 1));
+	uint num_added = 0;
+
+	// add the entries that are not in the plan yet
+	for (uint i = 0; i < entries->number_of_entries; i++) {
+		struct sce_node * n = sce_store_add(st, (entries->entries+i));
+		if (n) added[num_added++] = n;
+	}
+
+	sce_store_commit(st, added, num_added, c, proto);
+	mb_free(added);
+}
+
+/**
+ * Schedules the sces @added, that were just added to the store, and appends them to the journal.
+ *
+ * @st: the sce store
+ * @added: the new sces
+ * @num_added: number of the new sces
+ * @c: the used channel
+ * @proto: the bgp protocol
+ */
+void sce_store_commit(struct sce_store * st, struct sce_node ** added, uint num_added, struct channel * c, struct bgp_proto * proto) {
+	// schedule the begin and end of the new contacts at once
+	sce_sched_add_sces(&st->sched, added, num_added, c, proto);
+
+	// only the new sces are written to the journal
+	sce_journal_append(st, added, num_added, SCE_JR_ADD);
+}
+
+/**
+ * Hands the plan, that was loaded from SCES_FILENAME, over to the scheduler.
+ * Is only done once after the start, the expired contacts were already skipped
+ * by the load. The begin and end of future contacts are queued, but only the end
+ * of contacts that are open now: the routes they derive from are not known yet,
+ * so their routes are built later by sce_store_reopen().
+ *
+ * @st: the sce store
+ * @c: the used channel
+ * @proto: the bgp protocol
+ */
+void sce_store_restart(struct sce_store * st, struct channel * c, struct bgp_proto * proto) {
+	if (st->restarted) return;
+	st->restarted = 1;
+
+	BUFFER_(struct sce_node *) nodes;
+	BUFFER_INIT(nodes, st->pool, 16);
+
+	struct sce_node * n;
+	WALK_LIST(n, st->set.list)
+		if (!n->events[SCE_EV_BEGIN] && !n->events[SCE_EV_END])
+			BUFFER_PUSH(nodes) = n;
+
+	sce_sched_add(&st->sched, nodes.data, nodes.used, c, proto, 0);
+	mb_free(nodes.data);
+}
+
+/**
+ * Queues the begin of all contacts of channel @c, that are open now, again.
+ * Is called when the peer sent its routes after the session was established,
+ * e.g. after a restart or when the routes of the contacts were flushed with the
+ * routes of the peer. The routes of all these contacts are built in one batch
+ * by the next run of the scheduler.
+ *
+ * @st: the sce store
+ * @c: the channel whose routes were loaded
+ */
+void sce_store_reopen(struct sce_store * st, struct channel * c) {
+	struct sce_sched * s = &st->sched;
+	u64 now = sce_now();
+	uint queued = 0;
+
+	struct sce_node ** nodes;
+	uint num = sce_store_overlaps(st, now, now + 1, &nodes);
+
+	for (uint i = 0; i < num; i++) {
+		struct sce_event * end = nodes[i]->events[SCE_EV_END];
+
+		// the begin of the contact is still queued anyway
+		if (!end || (end->ed.ch != c) || nodes[i]->events[SCE_EV_BEGIN])
+			continue;
+
+		sce_sched_new_event(s, nodes[i], SCE_EV_BEGIN, c, end->ed.proto);
+
+		uint used = s->heap.used - 1;
+		HEAP_INSERT(s->heap.data, used, struct sce_event *, SCE_EV_LESS, SCE_EV_SWAP);
+		queued++;
+	}
+
+	mb_free(nodes);
+
+	if (queued) {
+		log(L_INFO "Rebuilding the routes of %u open scheduled contacts", queued);
+		sce_sched_arm(s);
+	}
+}
+
+/**
+ * Moves the queued events of channel @c to the IPv4 channel of another BGP
+ * protocol, before @c is freed with its protocol. The routes of the contacts,
+ * that are open now, are built in its table again. Without such a protocol,
+ * the events are cancelled and the plan is handed over again by the next
+ * sce_store_restart().
+ *
+ * @st: the sce store
+ * @c: the channel, that is going to be freed
+ */
+void sce_store_unbind(struct sce_store * st, struct channel * c) {
+	struct sce_sched * s = &st->sched;
+	struct channel * nc = NULL;
+	struct proto * P;
+
+	WALK_LIST(P, proto_list)
+		if ((P != c->proto) && (P->proto == &proto_bgp) && !P->disabled && !P->reconfiguring &&
+			(nc = sce_channel(P)))
+			break;
+
+	u64 now = sce_now();
+	uint moved = 0, reopened = 0;
+	struct sce_node * n;
+
+	WALK_LIST(n, st->set.list) {
+		struct sce_event * ev = n->events[SCE_EV_END] ?: n->events[SCE_EV_BEGIN];
+		if (!ev || (ev->ed.ch != c))
+			continue;
+
+		if (!nc) {
+			sce_sched_cancel(s, n);
+			continue;
+		}
+
+		for (u8 type = SCE_EV_BEGIN; type < SCE_EV_MAX; type++)
+			if ((ev = n->events[type])) {
+				ev->ed.ch = nc;
+				ev->ed.proto = (struct bgp_proto *) P;
+			}
+
+		// the prepared routes belong to the table of @c
+		if (n->stage) {
+			sce_stage_free(n->stage);
+			n->stage = NULL;
+
+			if (n->events[SCE_EV_BEGIN] && !n->events[SCE_EV_PREPARE])
+				BUFFER_PUSH(s->pending) = n;
+		}
+
+		if (!n->events[SCE_EV_BEGIN] && (n->e.start_time <= now)) {
+			sce_sched_new_event(s, n, SCE_EV_BEGIN, nc, (struct bgp_proto *) P);
+
+			uint used = s->heap.used - 1;
+			HEAP_INSERT(s->heap.data, used, struct sce_event *, SCE_EV_LESS, SCE_EV_SWAP);
+			reopened++;
+		}
+
+		moved++;
+	}
+
+	if (!nc) {
+		st->restarted = 0;
+		return;
+	}
+
+	if (s->pending.used)
+		ev_schedule_work(s->prepare);
+
+	if (reopened)
+		sce_sched_arm(s);
+
+	if (moved)
+		log(L_INFO "Moved %u scheduled contacts from %s to %s", moved, c->proto->name, P->name);
+}
+
+/*
+ * On-disk journal of the contact plan
+ */
+
+static u32 sce_crc_table[256];
+
+/**
+ * Returns the CRC-32 (IEEE 802.3) of @len bytes at @buf.
+ */
+static u32 sce_crc32(const byte * buf, uint len) {
+	if (!sce_crc_table[1]) {
+		for (u32 i = 0; i < 256; i++) {
+			u32 c = i;
+			for (int k = 0; k < 8; k++)
+				c = (c & 1) ? (0xedb88320 ^ (c >> 1)) : (c >> 1);
+			sce_crc_table[i] = c;
+		}
+	}
+
+	u32 crc = 0xffffffff;
+	for (uint i = 0; i < len; i++)
+		crc = sce_crc_table[(crc ^ buf[i]) & 0xff] ^ (crc >> 8);
+
+	return crc ^ 0xffffffff;
+}
+
+static void sce_journal_put_header(byte * buf) {
+	put_u32(buf, SCE_JOURNAL_MAGIC);
+	put_u16(buf + 4, SCE_JOURNAL_VERSION);
+	put_u16(buf + 6, SCE_JOURNAL_REC_SIZE);
+	put_u32(buf + 8, 0);
+	put_u32(buf + 12, sce_crc32(buf, 12));
+}
+
+static _Bool sce_journal_check_header(const byte * buf, size_t size) {
+	return (size >= SCE_JOURNAL_HDR_SIZE) &&
+		(get_u32(buf) == SCE_JOURNAL_MAGIC) &&
+		(get_u16(buf + 4) == SCE_JOURNAL_VERSION) &&
+		(get_u16(buf + 6) == SCE_JOURNAL_REC_SIZE) &&
+		(get_u32(buf + 12) == sce_crc32(buf, 12));
+}
+
+static void sce_journal_put_record(byte * buf, u8 type, const scheduled_contact_entry * e) {
+	buf[0] = type;
+	buf[1] = buf[2] = buf[3] = 0;
+	put_u64(buf + 4, e->start_time);
+	put_u64(buf + 12, e->duration);
+	put_u32(buf + 20, e->asn1);
+	put_u32(buf + 24, e->gw1);
+	put_u32(buf + 28, e->asn2);
+	put_u32(buf + 32, e->gw2);
+	put_u32(buf + 36, sce_crc32(buf, 36));
+}
+
+/**
+ * Decodes one record of the journal.
+ * Returns 0 if the checksum does not match or the type is unknown.
+ */
+static _Bool sce_journal_get_record(const byte * buf, u8 * type, scheduled_contact_entry * e) {
+	if (get_u32(buf + 36) != sce_crc32(buf, 36))
+		return 0;
+
+	*type = buf[0];
+	*e = (scheduled_contact_entry) {
+		.start_time = get_u64(buf + 4),
+		.duration = get_u64(buf + 12),
+		.asn1 = get_u32(buf + 20),
+		.gw1 = get_u32(buf + 24),
+		.asn2 = get_u32(buf + 28),
+		.gw2 = get_u32(buf + 32),
+	};
+
+	return (*type == SCE_JR_ADD) || (*type == SCE_JR_DEL);
+}
+
+static _Bool sce_journal_write(int fd, const byte * buf, size_t len) {
+	while (len) {
+		ssize_t n = write(fd, buf, len);
+		if (n < 0) return 0;
+		buf += n;
+		len -= n;
+	}
+	return 1;
+}
+
+/**
+ * Loads the plan from SCES_FILENAME into the store.
+ * The file is mapped and the records are decoded in place. Replaying stops at
+ * the first damaged record, e.g. a record torn by a crash while it was appended.
+ * A file in the old format (raw scheduled_contact_entry structs) is still accepted.
+ * A journal with a damaged or unknown header is moved aside, the plan starts empty.
+ * Returns 1 if the file can be appended to as it is, 0 if it has to be rewritten.
+ *
+ * @st: the sce store
+ */
+static _Bool sce_journal_load(struct sce_store * st) {
+	int fd = open(SCES_FILENAME, O_RDONLY);
+	if (fd < 0) return 0;
+
+	struct stat fileinfo;
+	if ((fstat(fd, &fileinfo) < 0) || !fileinfo.st_size) {
+		close(fd);
+		return 0;
+	}
+
+	size_t size = fileinfo.st_size;
+	byte * data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (data == MAP_FAILED) {
+		log(L_ERR "Cannot map scheduled contact entries from %s: %m", SCES_FILENAME);
+		return 0;
+	}
+
+	_Bool clean = 0;
+
+	if (sce_journal_check_header(data, size)) {
+		size_t pos = SCE_JOURNAL_HDR_SIZE;
+		scheduled_contact_entry e;
+		struct sce_node * n;
+		u8 type;
+
+		for (; pos + SCE_JOURNAL_REC_SIZE <= size; pos += SCE_JOURNAL_REC_SIZE) {
+			if (!sce_journal_get_record(data + pos, &type, &e))
+				break;
+
+			if (type == SCE_JR_ADD)
+				sce_store_add(st, &e);
+			else if ((n = sce_set_find(&st->set, &e)))
+				sce_store_remove(st, n);
+
+			st->journal_records++;
+		}
+
+		clean = (pos == size);
+		if (!clean)
+			log(L_WARN "Ignoring damaged tail of %s at offset %zu", SCES_FILENAME, pos);
+	}
+	else if ((size >= 4) && (get_u32(data) == SCE_JOURNAL_MAGIC)) {
+		// our journal, but damaged or written by a newer version
+		log(L_ERR "Invalid header of %s, moving it to %s and starting with an empty plan",
+			SCES_FILENAME, SCES_FILENAME ".bad");
+		if (rename(SCES_FILENAME, SCES_FILENAME ".bad") < 0)
+			log(L_ERR "Cannot rename %s: %m", SCES_FILENAME);
+	}
+	else if (!(size % sizeof(scheduled_contact_entry))) {
+		// old format without header
+		const scheduled_contact_entry * entry = (const void *) data;
+		for (size_t i = 0; i < size / sizeof(scheduled_contact_entry); i++)
+			sce_store_add(st, entry + i);
+	}
+	else
+		log(L_ERR "Unknown format of %s, ignoring it", SCES_FILENAME);
+
+	munmap(data, size);
+	return clean;
+}
+
+/**
+ * Opens SCES_FILENAME for appending, after the store was loaded from it.
+ *
+ * @st: the sce store
+ */
+static void sce_journal_open(struct sce_store * st) {
+	st->journal_fd = open(SCES_FILENAME, O_WRONLY | O_APPEND);
+	if (st->journal_fd < 0)
+		log(L_ERR "Cannot open %s: %m", SCES_FILENAME);
+}
+
+/**
+ * Writes a record of type @type for each of the sces @nodes to the journal with a single write.
+ */
+static void sce_journal_put(struct sce_store * st, struct sce_node ** nodes, uint count, u8 type) {
+	if (!count || (st->journal_fd < 0)) return;
+
+	size_t len = (size_t) count * SCE_JOURNAL_REC_SIZE;
+	byte * buf = mb_alloc(st->pool, len);
+
+	for (uint i = 0; i < count; i++)
+		sce_journal_put_record(buf + (size_t) i * SCE_JOURNAL_REC_SIZE, type, &nodes[i]->e);
+
+	if (!sce_journal_write(st->journal_fd, buf, len))
+		log(L_ERR "Cannot write scheduled contact entries to %s: %m", SCES_FILENAME);
+
+	mb_free(buf);
+	st->journal_records += count;
+}
+
+/**
+ * Compacts the journal when the stale records outweigh the sces in the store,
+ * or writes it anew if it is not open.
+ */
+static void sce_journal_check(struct sce_store * st) {
+	if ((st->journal_fd < 0) ||
+		(st->journal_records > 2 * sce_set_count(&st->set) + SCE_JOURNAL_MIN_COMPACT))
+		sce_store_save(st);
+}
+
+/**
+ * Appends a record of type @type for each of the sces @nodes to the journal
+ * with a single write. The journal is compacted when the stale records
+ * outweigh the sces in the store.
+ *
+ * @st: the sce store
+ * @nodes: the sces
+ * @count: number of the sces
+ * @type: SCE_JR_ADD or SCE_JR_DEL
+ */
+void sce_journal_append(struct sce_store * st, struct sce_node ** nodes, uint count, u8 type) {
+	if (!count) return;
+
+	sce_journal_put(st, nodes, count, type);
+	sce_journal_check(st);
+}
+
+/*
+ * Hash set of scheduled contact entries
+ */
+
+#define SCEH_KEY(n)		&n->key, n->hash
+#define SCEH_NEXT(n)		n->next
+#define SCEH_EQ(k1,h1,k2,h2)	h1 == h2 && !memcmp(k1, k2, sizeof(sce_key))
+#define SCEH_FN(k,h)		h
+
+#define SCEH_REHASH		sce_set_rehash
+#define SCEH_PARAMS		/8, *2, 2, 2, 8, 24
+
+HASH_DEFINE_REHASH_FN(SCEH, struct sce_node)
+
+/**
+ * Initializes an empty set of sces, allocated from @p.
+ *
+ * @set: the set
+ * @p: the pool for the nodes and the hash table
+ */
+void sce_set_init(struct sce_set * set, pool * p) {
+	set->pool = p;
+	set->slab = sl_new(p, sizeof(struct sce_node));
+	init_list(&set->list);
+	HASH_INIT(set->hash, p, 8);
+}
+
+/**
+ * Releases all nodes of the set.
+ *
+ * @set: the set
+ */
+void sce_set_free(struct sce_set * set) {
+	HASH_FREE(set->hash);
+	rfree(set->slab);
+	set->slab = NULL;
+	init_list(&set->list);
+}
+
+/**
+ * Finds the node of an entry, that is equal to @e (see check_equal_sces()).
+ *
+ * @set: the set
+ * @e: the entry to search for
+ */
+struct sce_node * sce_set_find(struct sce_set * set, const scheduled_contact_entry * e) {
+	sce_key key = sce_get_key(e);
+	return HASH_FIND(set->hash, SCEH, &key, sce_key_hash(&key));
+}
+
+/**
+ * Inserts a copy of @e to the set. Returns the new node, or NULL,
+ * if an equal entry is already included.
+ *
+ * @set: the set
+ * @e: the entry to insert
+ */
+struct sce_node * sce_set_add(struct sce_set * set, const scheduled_contact_entry * e) {
+	sce_key key = sce_get_key(e);
+	u32 hash = sce_key_hash(&key);
+
+	if (HASH_FIND(set->hash, SCEH, &key, hash))
+		return NULL;
+
+	struct sce_node * n = sl_allocz(set->slab);
+	n->hash = hash;
+	n->key = key;
+	n->e = *e;
+
+	HASH_INSERT2(set->hash, SCEH, set->pool, n);
+	add_tail(&set->list, &n->n);
+
+	return n;
+}
+
+/**
+ * Removes a node from the set and frees it.
+ *
+ * @set: the set
+ * @n: the node to remove
+ */
+void sce_set_remove(struct sce_set * set, struct sce_node * n) {
+	HASH_REMOVE2(set->hash, SCEH, set->pool, n);
+	rem_node(&n->n);
+	sl_free(set->slab, n);
+}
+
+
+/*
+ * Resident SCE store
+ */
+
+static struct sce_store * sce_store;
+
+static inline _Bool sce_is_valid(const scheduled_contact_entry * entry) {
+	return entry->start_time && entry->duration &&
+		entry->asn1 && entry->gw1 && entry->asn2 && entry->gw2;
+}
+
+/**
+ * Returns the time in milliseconds, for which a contact is kept after it ended.
+ */
+static inline u64 sce_retention(void) {
+	return (config ? config->sce_retention : SCE_RETENTION_DEFAULT) TO_MS;
+}
+
+static inline _Bool sce_is_expired(const scheduled_contact_entry * entry, u64 now) {
+	return sce_end_time(entry) + sce_retention() <= now;
+}
+
+static void sce_store_gc(timer * t) {
+	struct sce_store * st = t->data;
+	uint count = sce_store_expire(st, sce_now());
+
+	if (count)
+		log(L_INFO "Removed %u expired scheduled contact entries", count);
+}
+
+/**
+ * Returns the resident contact plan. On first use, the store is created
+ * and filled with the sces persisted in SCES_FILENAME.
+ */
+struct sce_store * sce_store_get(void) {
+	if (sce_store) return sce_store;
+
+	pool * p = rp_new(proto_pool, "SCE store");
+	sce_store = mb_allocz(p, sizeof(struct sce_store));
+	sce_store->pool = p;
+	sce_set_init(&sce_store->set, p);
+	sce_sched_init(&sce_store->sched, p);
+
+	sce_store->journal_fd = -1;
+
+	// expired sces in the journal are skipped by sce_store_add()
+	if (sce_journal_load(sce_store))
+		sce_journal_open(sce_store);
+
+	sce_journal_check(sce_store);
+
+	sce_store->gc_timer = tm_new_init(p, sce_store_gc, sce_store, SCE_GC_PERIOD, 0);
+	tm_start(sce_store->gc_timer, SCE_GC_PERIOD);
+
+	return sce_store;
+}
 
 /**
- * Register timers for every sce in the given entries.
- * One timer is registered for the start_time and the other one, when the
- * contact ends (start_time + duration)
+ * Adds a copy of @entry to the store and invalidates the cached CBOR encoding.
+ * Returns the new node, or NULL if the entry is invalid, expired or already known.
  *
- * @entries: the sces
- * @c: the used channel
- * @proto: the bgp_proto struct
+ * @st: the sce store
+ * @entry: the entry to add
  */
-void register_sces(scheduled_contact_entries * entries, struct channel *c, struct bgp_proto * proto) {
-	for (int i = 0; i < entries->number_of_entries; i++) {
-		scheduled_contact_entry * entry = (entries->entries+i);
+struct sce_node * sce_store_add(struct sce_store * st, const scheduled_contact_entry * entry) {
+	if (!sce_is_valid(entry) || sce_is_expired(entry, sce_now())) return NULL;
 
-		if (entry->start_time == 0 ||
-			entry->duration == 0 ||
-			entry->asn1 == 0 ||
-			entry->gw1 == 0 ||
-			entry->asn2 == 0 ||
-			entry->gw2 == 0) return;
+	struct sce_node * n = sce_set_add(&st->set, entry);
+	if (n) n->seq = ++st->version;
 
-		u64 begin = entry->start_time;
-		u64 end = entry->start_time + entry->duration;
-		register_timer(contact_begin, begin, entry, c, proto);
-		register_timer(contact_end, end, entry, c, proto);
-	}
+	return n;
 }
 
 /**
- * Here we register a timer that calls a given function on a given time.
+ * Removes the sce @n from the store and cancels its queued events.
+ * The caller is responsible for recording the removal in the journal.
  *
- * @hook: the function that is called
- * @when: the time in milliseconds since 01.01.2000 (UTC) when the timer should fire
- * @sce: the scheduled contact entry
- * @c: the used channel
- * @p: the bgp protocol struct
+ * @st: the sce store
+ * @n: the sce
+ */
+void sce_store_remove(struct sce_store * st, struct sce_node * n) {
+	sce_sched_cancel(&st->sched, n);
+	sce_set_remove(&st->set, n);
+	st->version++;
+}
+
+/**
+ * Removes the contacts, that ended longer than the retention window ago, from the store
+ * and records their removal in the journal. The next encoding of the plan does not
+ * contain them anymore. Returns the number of removed contacts.
  *
+ * @st: the sce store
+ * @now: the current time in milliseconds since 01.01.2000 (UTC)
+ */
+uint sce_store_expire(struct sce_store * st, u64 now) {
+	BUFFER_(struct sce_node *) expired;
+	BUFFER_INIT(expired, st->pool, 16);
+
+	struct sce_node * n;
+	WALK_LIST(n, st->set.list)
+		if (sce_is_expired(&n->e, now))
+			BUFFER_PUSH(expired) = n;
+
+	uint count = expired.used;
+
+	if (count) {
+		sce_journal_put(st, expired.data, count, SCE_JR_DEL);
+
+		for (uint i = 0; i < count; i++)
+			sce_store_remove(st, expired.data[i]);
+
+		sce_journal_check(st);
+		st->expired += count;
+	}
+
+	mb_free(expired.data);
+	return count;
+}
+
+// subtree of the interval index, @right is set when its left child was already visited
+struct sce_iv_cell {
+	int k;				// level of the node
+	uint x;				// position of the node
+	_Bool right;
+};
+
+static int sce_iv_cmp(const void * a, const void * b) {
+	const struct sce_iv * x = a;
+	const struct sce_iv * y = b;
+	return (x->start > y->start) - (x->start < y->start);
+}
+
+/*
+ * Builds the interval index from the contacts of the store. A node at level k
+ * is at a position with k trailing ones, its children are 2^(k-1) positions
+ * to the left and to the right. The subtrees at the right border may be
+ * incomplete, their missing children inherit the latest end seen so far.
  */
-timer * register_timer(void (*hook)(struct timer *),
-		u64 when, scheduled_contact_entry * sce, struct channel *c,
-		struct bgp_proto * proto) {
+static void sce_itree_build(struct sce_itree * t, struct sce_store * st) {
+	t->ivs.used = 0;
+
+	struct sce_node * n;
+	WALK_LIST(n, st->set.list)
+		BUFFER_PUSH(t->ivs) = (struct sce_iv) {
+			.start = n->e.start_time,
+			.end = sce_end_time(&n->e),
+			.node = n,
+		};
+
+	struct sce_iv * a = t->ivs.data;
+	uint num = t->ivs.used;
+	qsort(a, num, sizeof(struct sce_iv), sce_iv_cmp);
+
+	t->version = st->version;
+	t->levels = -1;
+	if (!num) return;
+
+	uint last_i = 0;
+	u64 last = 0;
+	for (uint i = 0; i < num; i += 2) {
+		last_i = i;
+		last = a[i].max = a[i].end;
+	}
 
-	entry_data * edata = malloc(sizeof(entry_data));
+	int k;
+	for (k = 1; (1U << k) <= num; k++) {
+		uint x = 1U << (k - 1);
 
-	edata->sce = sce;
-	edata->ch = c;
-	edata->proto = proto;
+		for (uint i = (x << 1) - 1; i < num; i += x << 2) {
+			u64 el = a[i - x].max;
+			u64 er = (i + x < num) ? a[i + x].max : last;
+			a[i].max = MAX(a[i].end, MAX(el, er));
+		}
 
-	u64 firetime = convert_unixtime_to_secfromnow(when);
-	timer * tm = tm_new_init(NULL, hook, edata, 0, 0);
+		last_i = ((last_i >> k) & 1) ? last_i - x : last_i + x;
+		if ((last_i < num) && (a[last_i].max > last))
+			last = a[last_i].max;
+	}
 
-	tm_start(tm, firetime*1000);
-	return tm;
+	t->levels = k - 1;
 }
 
 /**
- * Called by the timer when a contact begins.
- * Invokes the path calculations.
+ * Collects the contacts of the plan, whose windows overlap [@start, @end).
+ * The contacts open at a time T are found by [T, T + 1).
+ * Returns the number of contacts, the array is allocated from the store pool and must be freed with mb_free().
  *
- * @t: the timer that called this method containing entry_data
+ * @st: the sce store
+ * @start: begin of the queried window in milliseconds since 01.01.2000 (UTC)
+ * @end: end of the queried window, exclusive
+ * @nodes: will point to the array of contacts
  */
-void
-contact_begin(timer *t) {
-	entry_data * ed = ((entry_data *) t->data );
+uint sce_store_overlaps(struct sce_store * st, u64 start, u64 end, struct sce_node *** nodes) {
+	struct sce_itree * t = &st->itree;
+
+	if (!t->ivs.data) {
+		BUFFER_INIT(t->ivs, st->pool, 16);
+		t->version = st->version - 1;
+	}
+
+	if (t->version != st->version)
+		sce_itree_build(t, st);
 
-	log(L_INFO "\n ==> Begin of contact between AS%u and AS%u !", ed->sce->asn1, ed->sce->asn2);
+	BUFFER_(struct sce_node *) buf;
+	BUFFER_INIT(buf, st->pool, 16);
 
-	if (ed) {
-		modify_routingtable_add(ed);
+	struct sce_iv * a = t->ivs.data;
+	uint num = t->ivs.used;
+
+	// subtrees still to visit, the depth of the stack is bounded by twice the number of levels
+	struct sce_iv_cell stack[64];
+	uint depth = 0;
+
+	if (t->levels >= 0)
+		stack[depth++] = (struct sce_iv_cell) { t->levels, (1U << t->levels) - 1, 0 };
+
+	while (depth) {
+		struct sce_iv_cell z = stack[--depth];
+
+		// small subtrees are scanned linearly
+		if (z.k <= 3) {
+			uint i0 = z.x >> z.k << z.k;
+			uint i1 = MIN(i0 + (1U << (z.k + 1)) - 1, num);
+
+			for (uint i = i0; (i < i1) && (a[i].start < end); i++)
+				if (start < a[i].end)
+					BUFFER_PUSH(buf) = a[i].node;
+		}
+		else if (!z.right) {
+			// the left child may be beyond the last interval
+			uint y = z.x - (1U << (z.k - 1));
+			stack[depth++] = (struct sce_iv_cell) { z.k, z.x, 1 };
+
+			if ((y >= num) || (a[y].max > start))
+				stack[depth++] = (struct sce_iv_cell) { z.k - 1, y, 0 };
+		}
+		else if ((z.x < num) && (a[z.x].start < end)) {
+			if (start < a[z.x].end)
+				BUFFER_PUSH(buf) = a[z.x].node;
+
+			stack[depth++] = (struct sce_iv_cell) { z.k - 1, z.x + (1U << (z.k - 1)), 0 };
+		}
 	}
+
+	*nodes = buf.data;
+	return buf.used;
 }
 
 /**
- * Called by the timer when a contact ends.
- * Invokes the path calculations.
+ * Returns a contact of the plan between the same ASes as @e, other than @e itself,
+ * that is open at @at, or NULL if there is none.
  *
- * @t: the timer that called this method containing entry_data
+ * @st: the sce store
+ * @e: the contact
+ * @at: the time in milliseconds since 01.01.2000 (UTC)
  */
-void
-contact_end(timer *t) {
-	entry_data * ed = ((entry_data *) t->data );
+struct sce_node * sce_store_pair_open(struct sce_store * st, const scheduled_contact_entry * e, u64 at) {
+	sce_key key = sce_get_key(e);
+	struct sce_node * found = NULL;
+
+	struct sce_node ** nodes;
+	uint num = sce_store_overlaps(st, at, at + 1, &nodes);
 
-	log(L_INFO "\n ==> End of contact between AS%u and AS%u !", ed->sce->asn1, ed->sce->asn2);
+	for (uint i = 0; !found && (i < num); i++) {
+		sce_key * k = &nodes[i]->key;
 
-	if (ed) {
-		modify_routingtable_remove(ed);
+		if ((k->asn_lo == key.asn_lo) && (k->asn_hi == key.asn_hi) && memcmp(k, &key, sizeof(sce_key)))
+			found = nodes[i];
 	}
 
-	// release resources
-	tm_stop(t);
-	rfree(t);
+	mb_free(nodes);
+	return found;
 }
 
 /**
- *  milliseconds since 01.01.2000 UTC are converted to seconds since now.
+ * Compacts the journal: all sces of the store are written to a new file,
+ * which atomically replaces SCES_FILENAME. Appending continues in the new file.
  *
- * @relative_time: milliseconds since 01.01.2000 UTC
+ * @st: the sce store
  */
-u64 convert_unixtime_to_secfromnow(u64 relative_time) {
-	u64 current_time = time(NULL) * 1000;
-	return (relative_time + DTNEPOCH) - current_time;
-}
+void sce_store_save(struct sce_store * st) {
+	const char * tmpname = SCES_FILENAME ".tmp";
+	uint count = sce_set_count(&st->set);
+	size_t len = SCE_JOURNAL_HDR_SIZE + (size_t) count * SCE_JOURNAL_REC_SIZE;
+	byte * buf = mb_alloc(st->pool, len);
+	byte * pos = buf + SCE_JOURNAL_HDR_SIZE;
+
+	sce_journal_put_header(buf);
+
+	struct sce_node * n;
+	WALK_LIST(n, st->set.list) {
+		sce_journal_put_record(pos, SCE_JR_ADD, &n->e);
+		pos += SCE_JOURNAL_REC_SIZE;
+	}
 
+	int fd = open(tmpname, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	_Bool ok = (fd >= 0) && sce_journal_write(fd, buf, len) && !fsync(fd);
+
+	if (fd >= 0)
+		close(fd);
+
+	mb_free(buf);
+
+	if (!ok || (rename(tmpname, SCES_FILENAME) < 0)) {
+		log(L_ERR "Cannot write scheduled contact entries to %s: %m", SCES_FILENAME);
+		unlink(tmpname);
+		return;
+	}
+
+	if (st->journal_fd >= 0)
+		close(st->journal_fd);
+
+	st->journal_records = count;
+	sce_journal_open(st);
+}
 
 /*
- * Handling, saving, registering scheduled contact entries
+ * CLI
  */
 
-/* Stores an sce struct in a file pointed by fd.
- * The struct's raw bytes are stored.
- *
- * @fd: pointer to a file descriptor
- * @entry: the data that needs to be saved
- */
-void store_sce(FILE *fd, scheduled_contact_entry *entry) {
-	fwrite(entry, sizeof(*entry), 1, fd);
+static const char * sce_state_names[] = {
+	[SCE_SHOW_ACTIVE] = "active",
+	[SCE_SHOW_PENDING] = "pending",
+	[SCE_SHOW_EXPIRED] = "expired",
+};
+
+static int sce_state(const scheduled_contact_entry * e, u64 now) {
+	if (e->start_time > now)
+		return SCE_SHOW_PENDING;
+
+	return (sce_end_time(e) > now) ? SCE_SHOW_ACTIVE : SCE_SHOW_EXPIRED;
 }
 
-/**
- * Stores all sces in a file named SCES_FILENAME.
- *
- * @entries: the scheduled contact entries
- * @c: the used channel
- * @proto: the bgp protocol
- */
-void store_sces(scheduled_contact_entries *entries, struct channel *c, struct bgp_proto * proto) {
+static _Bool sce_show_match(struct sce_show_data * d, const scheduled_contact_entry * e, u64 now) {
+	if (d->asn && (e->asn1 != d->asn) && (e->asn2 != d->asn))
+		return 0;
 
-	// merge existing sces with the new ones to store all together
-	scheduled_contact_entries * existing_sces = load_sces();
-	scheduled_contact_entries * all_sces;
+	return !d->state || (sce_state(e, now) == d->state);
+}
 
-	// if there are new sces, register timers for them
-	if (existing_sces) {
-		all_sces = merge_sces(entries, existing_sces);
+static void sce_show_hist(const char * name, struct sce_hist * h) {
+	const u32 * b = h->buckets;
+	btime avg = h->count ? (h->total / h->count) : 0;
 
-		// find the new entries that are not in the existing entries and register timers for them
-		scheduled_contact_entries * new_entries = find_new_sces(entries, existing_sces);
-		register_sces(new_entries, c, proto);
-	} else {
-		all_sces = entries;
+	cli_msg(-1026, "  %-10s %8u %10.6t %10.6t %7u %7u %7u %7u %7u %7u %7u",
+		name, h->count, avg, h->max, b[0], b[1], b[2], b[3], b[4], b[5], b[6]);
+}
 
-		// if all entries are new (they are because there weren't existing),
-		// register new timers for every sce
-		register_sces(entries, c, proto);
+static void sce_show_contact(struct cli * c, struct sce_node * n, u64 now) {
+	scheduled_contact_entry * e = &n->e;
+	struct sce_stats * st = &n->stats;
+	byte start[TM_DATETIME_BUFFER_SIZE];
 
-	}
+	if (!tm_format_real_time(start, sizeof(start), "%F %T", (btime) (e->start_time + DTNEPOCH) MS_))
+		strcpy(start, "<error>");
 
-	FILE *fd = fopen(SCES_FILENAME, "w");
+	cli_printf(c, -1026, "%-19s %10.3t %10u %10u %-7s %8u %9u %10.6t %10.6t %10.6t",
+		start, (btime) e->duration MS_, e->asn1, e->asn2, sce_state_names[sce_state(e, now)],
+		st->added, st->withdrawn, st->add_time, st->remove_time, st->latency);
+}
+
+static void sce_show_cont(struct cli * c) {
+	struct sce_show_data * d = c->rover;
+	struct sce_store * st = sce_store_get();
+	u64 now = sce_now();
+	uint max = 64;
+
+	// the plan changed, continue behind the last visited contact
+	if (d->version != st->version) {
+		struct sce_node * n;
+		WALK_LIST(n, st->set.list)
+			if (n->seq > d->last)
+				break;
+
+		d->next = n;
+		d->version = st->version;
+	}
 
-	for (int i = 0; i < all_sces->number_of_entries; i++) {
-		scheduled_contact_entry * entry = (all_sces->entries+i);
+	struct sce_node * n = d->next;
+	for (; NODE_VALID(n); n = NODE_NEXT(n)) {
+		if (!max--) {
+			d->next = n;
+			return;
+		}
 
-		if (entry->start_time == 0 ||
-			entry->duration == 0 ||
-			entry->asn1 == 0 ||
-			entry->gw1 == 0 ||
-			entry->asn2 == 0 ||
-			entry->gw2 == 0) continue;
+		if (sce_show_match(d, &n->e, now)) {
+			sce_show_contact(c, n, now);
+			d->shown++;
+		}
 
-		store_sce(fd, (all_sces->entries+i));
+		d->last = n->seq;
 	}
 
-	fclose(fd);
+	cli_printf(c, 0, "%u contacts shown", d->shown);
+	c->cont = c->cleanup = NULL;
 }
 
 /**
- * Load all sces that are stored in SCES_FILENAME and return a pointer pointing to them.
+ * Implements "show sce". Prints the summary of the plan and the latency
+ * histograms at once, the matching contacts are streamed by sce_show_cont().
+ *
+ * @d: the options of the command
  */
-scheduled_contact_entries * load_sces(void) {
+void sce_show(struct sce_show_data * d) {
+	struct sce_store * st = sce_store_get();
+	struct sce_sched * s = &st->sched;
+	u64 now = sce_now();
+	uint num[SCE_SHOW_EXPIRED + 1] = {};
+
+	struct sce_node * n;
+	WALK_LIST(n, st->set.list)
+		num[sce_state(&n->e, now)]++;
+
+	cli_msg(-1026, "Scheduled contacts: %u active, %u pending, %u expired",
+		num[SCE_SHOW_ACTIVE], num[SCE_SHOW_PENDING], num[SCE_SHOW_EXPIRED]);
+	cli_msg(-1026, "Events fired: %u, contacts prepared: %u, contacts removed: %u, clock steps: %u",
+		s->fired, s->prepared, st->expired, s->steps);
+	cli_msg(-1026, "  %-10s %8s %10s %10s %7s %7s %7s %7s %7s %7s %7s",
+		"Latency", "Count", "Average", "Maximum", "<100us", "<1ms", "<10ms", "<100ms", "<1s", "<10s", ">=10s");
+	sce_show_hist("Add", &s->add_hist);
+	sce_show_hist("Remove", &s->remove_hist);
+	sce_show_hist("Activation", &s->latency_hist);
+	cli_msg(-2026, "%-19s %10s %10s %10s %-7s %8s %9s %10s %10s %10s",
+		"Start", "Duration", "AS1", "AS2", "State", "Added", "Withdrawn", "Add time", "Remove", "Latency");
+
+	d->next = HEAD(st->set.list);
+	d->version = st->version;
+
+	this_cli->cont = sce_show_cont;
+	this_cli->cleanup = NULL;
+	this_cli->rover = d;
+}
 
-	// check if file exists and how large it is
-	struct stat fileinfo;
-	int exists = stat(SCES_FILENAME, &fileinfo);
+/**
+ * Returns the IPv4 channel of the BGP protocol @P, or NULL if there is none.
+ * The routes of the contacts are computed in its table.
+ */
+struct channel * sce_channel(struct proto * P) {
+	struct channel * c;
+	WALK_LIST(c, P->channels)
+		if (!strcmp(c->name, "ipv4"))
+			return c;
 
-	if (exists != 0) {
-		return NULL;
+	return NULL;
+}
+
+/**
+ * Implements "sce load". Loads the plan file @name like the option "sce plan",
+ * even if it did not change. The new contacts are scheduled on the IPv4 channel
+ * of the first BGP protocol, that has one.
+ *
+ * @name: name of the file
+ */
+void sce_load(const char * name) {
+	if (cli_access_restricted())
+		return;
+
+	struct proto * P;
+	struct channel * c = NULL;
+	WALK_LIST(P, proto_list)
+		if ((P->proto == &proto_bgp) && (c = sce_channel(P)))
+			break;
+
+	if (!c) {
+		cli_msg(8003, "No BGP protocol with IPv4 channel");
+		return;
 	}
 
-	int filesize = fileinfo.st_size;
+	int added = sce_store_load_file(sce_store_get(), name, 1, c, (struct bgp_proto *) P);
+	if (added < 0)
+		cli_msg(8009, "Cannot load scheduled contacts from %s, see the log", name);
+	else
+		cli_msg(26, "%d new scheduled contacts loaded from %s", added, name);
+}
 
-	int num_of_entries = filesize / sizeof(scheduled_contact_entry);
+// upper bound for the size of the CBOR encoding of @n sces:
+// the array header and per entry an array header, two u64 and four u32,
+// if all fields reach their max. values
+#define SCE_CBOR_MAX_SIZE(n)	(5 + (n) * (1 + 2*9 + 4*5))
 
-	if (num_of_entries < 1) return NULL;
+/**
+ * Encodes @count sces of the store to CBOR, starting with @n in the order of the store.
+ * Returns the end of the encoded data.
+ *
+ * @data: the buffer, at least SCE_CBOR_MAX_SIZE(@count) bytes long
+ * @n: the first sce
+ * @count: number of the sces
+ */
+static byte * sce_cbor_encode_entry(byte * data, const scheduled_contact_entry * e) {
+	uint size = SCE_CBOR_MAX_SIZE(1);
+
+	data = cbor_write_array(data, size, 6);
+	data = cbor_write_long(data, size, e->start_time);
+	data = cbor_write_long(data, size, e->duration);
+	data = cbor_write_int(data, size, e->asn1);
+	data = cbor_write_int(data, size, e->gw1);
+	data = cbor_write_int(data, size, e->asn2);
+	data = cbor_write_int(data, size, e->gw2);
+
+	return data;
+}
 
-	FILE *fd = fopen(SCES_FILENAME, "rb");
+static byte * sce_cbor_encode(byte * data, struct sce_node * n, uint count) {
+	data = cbor_write_array(data, SCE_CBOR_MAX_SIZE(count), count);
 
-	scheduled_contact_entry * entry = malloc(sizeof(scheduled_contact_entry) * num_of_entries);
+	for (uint i = 0; i < count; i++, n = NODE_NEXT(n))
+		data = sce_cbor_encode_entry(data, &n->e);
 
-	// read number of sces from the file
-	fread(entry, sizeof(scheduled_contact_entry) * num_of_entries, 1, fd);
+	return data;
+}
 
-	fclose(fd);
+/**
+ * Encodes the sces of the store to CBOR, if the cached encoding is outdated.
+ *
+ * @st: the sce store
+ */
+static void sce_store_encode(struct sce_store * st) {
+	uint num_of_entries = sce_set_count(&st->set);
+	uint size = SCE_CBOR_MAX_SIZE(num_of_entries);
+
+	if (size > st->cbor_size) {
+		if (st->cbor) mb_free(st->cbor);
+		st->cbor = mb_alloc(st->pool, size);
+		st->cbor_size = size;
+	}
 
-	scheduled_contact_entries * sce = malloc( sizeof(scheduled_contact_entries) );
-	sce->entries = entry;
-	sce->number_of_entries = num_of_entries;
+	byte * end = sce_cbor_encode(st->cbor, HEAD(st->set.list), num_of_entries);
 
-	return sce;
+	st->cbor_len = end - st->cbor;
+	st->cbor_version = st->version;
 }
 
 /**
  * Finds which sces from the first sces @new are new i.e. not included in the second sces @existing
- * and returns them.
+ * and returns them. Duplicates within @new are returned only once.
  *
  * @new: the new sces, where new ones are searched.
  * @existing: the existing sces
  */
 scheduled_contact_entries * find_new_sces(scheduled_contact_entries * new, scheduled_contact_entries * existing) {
 
-	// first find out how many new sces exists to malloc
-	int num_of_new = 0;
-
-	for (int i = 0; i < new->number_of_entries; i++) {
-		scheduled_contact_entry * new_e = (new->entries+i);
-		_Bool newone = 1;
+	pool * tmp = rp_new(&root_pool, "SCE diff");
+	struct sce_set seen;
+	sce_set_init(&seen, tmp);
 
-		// check signature of the entry against all existing signatures
-		for (int j = 0; j < existing->number_of_entries; j++) {
-			scheduled_contact_entry * existing_e = (existing->entries+j);
-			if (check_equal_sces(new_e, existing_e)) newone = 0;
-		}
-
-		// if newone is still 1, the sce is new
-		if (newone) {
-			num_of_new++;
-		}
-	}
+	for (uint j = 0; j < existing->number_of_entries; j++)
+		sce_set_add(&seen, (existing->entries+j));
 
-	scheduled_contact_entry * entry_array = malloc(sizeof(scheduled_contact_entry) * num_of_new);
-
-	// store the new entries in entry
-	int pos = 0;
-	for (int i = 0; i < new->number_of_entries; i++) {
-		scheduled_contact_entry * new_e = (new->entries+i);
-		_Bool newone = 1;
-
-		for (int j = 0; j < existing->number_of_entries; j++) {
-			scheduled_contact_entry * existing_e = (existing->entries+j);
-			if (check_equal_sces(new_e, existing_e)) newone = 0;
-		}
+	scheduled_contact_entry * entry_array = malloc(sizeof(scheduled_contact_entry) * MAX(new->number_of_entries, 1));
 
-		// if newone is still 1, the sce is new
-		// pos is incremented to move array pointer forward
-		if (newone) {
+	// an entry is new, if it can be inserted in the set of already seen entries
+	uint pos = 0;
+	for (uint i = 0; i < new->number_of_entries; i++) {
+		if (sce_set_add(&seen, (new->entries+i))) {
 			*(entry_array+pos) = *(new->entries+i);
 			pos++;
 		}
 	}
 
+	rfree(tmp);
+
 	scheduled_contact_entries * entries = malloc(sizeof(scheduled_contact_entries));
-	entries->number_of_entries = num_of_new;
+	entries->number_of_entries = pos;
 	entries->entries = entry_array;
 
 	return entries;
@@ -1055,87 +3687,49 @@ scheduled_contact_entries * find_new_sces(scheduled_contact_entries * new, sched
 }
 
 /**
- * Checks if two sces are equal, if so it returns 1, otherwise 0;
+ * Checks if two sces are equal, if so it returns 1, otherwise 0.
+ * Two entries are equal if they have the same canonical key, i.e. the same
+ * times and the same two (ASN, gateway) sides in any order.
  *
  * @entry1: the first scheduled contact entry
  * @entry2: the second scheduled contact entry
  */
 _Bool check_equal_sces(scheduled_contact_entry * entry1, scheduled_contact_entry * entry2) {
-	if (entry1->start_time != entry2->start_time) return 0;
-	if (entry1->duration != entry2->duration) return 0;
-
-	if (entry1->asn1 != entry2->asn1 &&
-		entry1->asn1 != entry2->asn2) return 0;
-	if (entry1->asn2 != entry2->asn1 &&
-		entry1->asn2 != entry2->asn2) return 0;
-
-	if (entry1->asn1 == entry2->asn1) {
-		if (entry1->asn2 != entry2->asn2) return 0;
-	}
-	if (entry1->asn1 == entry2->asn2) {
-		if (entry1->asn2 != entry2->asn1) return 0;
-	}
-
-	if (entry1->gw1 == entry2->gw1) {
-		if (entry1->gw2 != entry2->gw2) return 0;
-	}
-	if (entry1->gw1 == entry2->gw2) {
-		if (entry1->gw2 != entry2->gw1) return 0;
-	}
+	sce_key key1 = sce_get_key(entry1);
+	sce_key key2 = sce_get_key(entry2);
 
-	return 1;
+	return !memcmp(&key1, &key2, sizeof(sce_key));
 }
 
 /**
  * Takes two sets of scheduled contact entries and merges them to one.
+ * The entries of @entries1 come first, duplicates are only included once.
  *
  * @entries1: the first set of sces
  * @entries2: the second set of sces
  */
 scheduled_contact_entries * merge_sces(scheduled_contact_entries *entries1, scheduled_contact_entries *entries2)
 {
+	pool * tmp = rp_new(&root_pool, "SCE merge");
+	struct sce_set all;
+	sce_set_init(&all, tmp);
+
+	for (uint i = 0; i < entries1->number_of_entries; i++)
+		sce_set_add(&all, (entries1->entries+i));
+	for (uint i = 0; i < entries2->number_of_entries; i++)
+		sce_set_add(&all, (entries2->entries+i));
+
 	scheduled_contact_entries * entries = malloc(sizeof(scheduled_contact_entries));
-	int num_of_entries = 0;
-	int duplicates = 0;
-	/*
-	 * For initializing the scheduled_contact_entry array we need to calculate the size.
-	 * We test if signatures are identical.
-	 */
-	for (int i = 0; i < entries1->number_of_entries; i++) {
-		scheduled_contact_entry * e1 = (entries1->entries+i);
-		for (int j = 0; j < entries2->number_of_entries; j++) {
-			scheduled_contact_entry * e2 = (entries2->entries+j);
-			if (check_equal_sces(e1, e2)) duplicates++;
-		}
-	}
-	num_of_entries = entries1->number_of_entries + entries2->number_of_entries - duplicates;
-	scheduled_contact_entry * entry_array = malloc(sizeof(scheduled_contact_entry)*num_of_entries);
-	/*
-	 * first add every entry of entries1
-	 * and later add every entry of entries2, but
-	 * check if the duplicate entry is inserted
-	 * This presupposes that there are no duplicates in entry1
-	 */
-	int index = 0;
-	for (int i = 0; i < entries1->number_of_entries; i++) {
-		*(entry_array+i) = *(entries1->entries+i);
-		index++;
-	}
-	for (int i = 0; i < entries2->number_of_entries; i++) {
-		// only add the entries, that are not added yet, check added entries from entries1
-		_Bool duplicate = 0;
-		scheduled_contact_entry * e1 = (entries2->entries+i);
-		// compare signature of entry2 against every signature of entry1
-		for (int j = 0; j < entries1->number_of_entries; j++) {
-			scheduled_contact_entry * e2 = (entries1->entries+j);
-			if (check_equal_sces(e1, e2)) duplicate = 1;	// if signature of entry1 & entry2 is identical --> duplicate --> entry2 not added
-		}
-		if (!duplicate) {
-			*(entry_array+index) = *(entries2->entries+i);
-			index++;
-		}
-	}
-	entries->number_of_entries = num_of_entries;
+	scheduled_contact_entry * entry_array = malloc(sizeof(scheduled_contact_entry) * MAX(sce_set_count(&all), 1));
+
+	uint index = 0;
+	struct sce_node * n;
+	WALK_LIST(n, all.list)
+		*(entry_array+index++) = n->e;
+
+	rfree(tmp);
+
+	entries->number_of_entries = index;
 	entries->entries = entry_array;
 
 	return entries;
@@ -1149,7 +3743,7 @@ scheduled_contact_entries * merge_sces(scheduled_contact_entries *entries1, sche
 void print_sces(scheduled_contact_entries *entries) {
 	if (!(entries)) return;
 	log(L_INFO "===============\nPrinting %u scheduled contact entries.", entries->number_of_entries);
-	for (int i = 0; i < entries->number_of_entries; i++) {
+	for (uint i = 0; i < entries->number_of_entries; i++) {
 		log(L_INFO "Entry %u:\n  =>  %" PRIu64 " %" PRIu64 " %u %u %u %u",
 				i+1, (entries->entries+i)->start_time, (entries->entries+i)->duration,
 				(entries->entries+i)->asn1, (entries->entries+i)->gw1,
@@ -1165,43 +3759,411 @@ void print_sces(scheduled_contact_entries *entries) {
  */
 
 /**
- * Encode scheduled contact entries to CBOR.
+ * Returns the CBOR encoding of the resident contact plan.
+ * The buffer is owned by the sce store and is valid until the plan changes.
  *
  * @data_size: will contain the size of the data
  */
 unsigned char * get_sces_cbor(unsigned int * data_size) {
-	scheduled_contact_entries * entries = load_sces();
+	struct sce_store * st = sce_store_get();
+
+	if (sce_set_count(&st->set) == 0) return NULL;
+
+	if (st->cbor_version != st->version || !st->cbor)
+		sce_store_encode(st);
+
+	*data_size = st->cbor_len;
+
+	return st->cbor;
+}
+
+/**
+ * Returns the CBOR encoding of the sces that were added to the plan after its version @since,
+ * or NULL if there are none. If they do not fit into @max bytes, only the oldest of them are
+ * encoded, the rest is left for the next call. @upto is set to the version of the plan the
+ * receiver knows after it got the encoded sces. The cached encoding of the whole plan is
+ * used, if possible, otherwise the sces are encoded to a buffer from @lp.
+ *
+ * @since: version of the plan the receiver already knows
+ * @max: max. size of the encoding
+ * @lp: linpool for the encoding of the new sces
+ * @data_size: will contain the size of the data
+ * @upto: will contain the version of the plan, that is encoded
+ */
+unsigned char * get_sces_cbor_since(u32 since, uint max, linpool * lp, unsigned int * data_size, u32 * upto) {
+	struct sce_store * st = sce_store_get();
+
+	// the sces are kept in the order they were added
+	struct sce_node * first = NULL;
+	uint count = 0;
+
+	WALK_LIST_BACKWARDS(first, st->set.list) {
+		if (first->seq <= since) break;
+		count++;
+	}
+
+	if (!count) return NULL;
+
+	if (count == sce_set_count(&st->set)) {
+		byte * data = get_sces_cbor(data_size);
+
+		if (*data_size <= max) {
+			*upto = st->version;
+			return data;
+		}
+	}
+
+	// an encoded sce takes at least 7 bytes, the array header at most 5 bytes
+	uint limit = MIN(count, max / 7 + 1);
+	byte * data = lp_alloc(lp, SCE_CBOR_MAX_SIZE(limit));
+	byte * pos = data + 5;
+	byte hdr[5];
+
+	struct sce_node * n = first;
+	uint num = 0;
+
+	for (; num < limit; num++) {
+		struct sce_node * next = NODE_NEXT(n);
+		byte * end = sce_cbor_encode_entry(pos, &next->e);
+
+		if ((cbor_write_array(hdr, sizeof(hdr), num + 1) - hdr) + (end - (data + 5)) > max)
+			break;
+
+		n = next;
+		pos = end;
+	}
+
+	if (!num) return NULL;
+
+	// the array header is put right in front of the sces
+	uint hlen = cbor_write_array(hdr, sizeof(hdr), num) - hdr;
+	data += 5 - hlen;
+	memcpy(data, hdr, hlen);
+
+	*data_size = pos - data;
+	*upto = (num == count) ? st->version : n->seq;
+	return data;
+}
+
+/**
+ * Reads the head of a CBOR data item of major type @major at *@pos
+ * and returns its argument in @val. The position is moved behind the head.
+ * Returns 0 if the item has another type, is truncated or has an indefinite length.
+ */
+static inline _Bool sce_cbor_get_head(const byte ** pos, const byte * end, u8 major, u64 * val) {
+	const byte * p = *pos;
+
+	if ((p >= end) || ((*p >> 5) != major)) return 0;
+
+	u8 info = *p++ & 0x1f;
+	if (info > 27) return 0;
+
+	uint size = (info < 24) ? 0 : (1 << (info - 24));
+	if (size > (uint) (end - p)) return 0;
+
+	switch (size) {
+	case 0: *val = info; break;
+	case 1: *val = *p; break;
+	case 2: *val = get_u16(p); break;
+	case 4: *val = get_u32(p); break;
+	default: *val = get_u64(p); break;
+	}
+
+	*pos = p + size;
+	return 1;
+}
+
+/**
+ * Decodes one sce, an array [start_time, duration, asn1, gw1, asn2, gw2] of unsigned integers.
+ * Returns 0 if the sce is malformed.
+ */
+static inline _Bool sce_cbor_get_sce(const byte ** pos, const byte * end, scheduled_contact_entry * e) {
+	u64 v[6];
+
+	// fast path for the array header of a sce, as written by sce_store_encode()
+	if ((*pos < end) && (**pos == 0x86))
+		(*pos)++;
+	else if (!sce_cbor_get_head(pos, end, 4, v) || (v[0] != 6))
+		return 0;
+
+	for (uint i = 0; i < 6; i++)
+		if (!sce_cbor_get_head(pos, end, 0, v + i))
+			return 0;
+
+	if ((v[2] | v[3] | v[4] | v[5]) > 0xffffffff)
+		return 0;
+
+	*e = (scheduled_contact_entry) {
+		.start_time = v[0],
+		.duration = v[1],
+		.asn1 = v[2],
+		.gw1 = v[3],
+		.asn2 = v[4],
+		.gw2 = v[5],
+	};
+
+	return 1;
+}
+
+/**
+ * Walks the sces of a BA_SCHEDULED payload.
+ * If @st is given, the sces are added to the store and the new ones are put to @added.
+ * Returns the number of sces, or -1 if the payload is malformed.
+ */
+static int sce_cbor_walk(const byte * data, uint len, struct sce_store * st, struct sce_node ** added, uint * num_added) {
+	const byte * pos = data;
+	const byte * end = data + len;
+	u64 count;
+
+	// every sce takes at least 7 bytes, a larger count can not be valid
+	if (!sce_cbor_get_head(&pos, end, 4, &count) || (count > (u64) (end - pos) / 7))
+		return -1;
+
+	for (uint i = 0; i < count; i++) {
+		scheduled_contact_entry e;
+
+		if (!sce_cbor_get_sce(&pos, end, &e))
+			return -1;
+
+		if (st) {
+			struct sce_node * n = sce_store_add(st, &e);
+			if (n) added[(*num_added)++] = n;
+		}
+	}
 
-	if (entries == NULL) return NULL;
+	return (pos == end) ? (int) count : -1;
+}
+
+/**
+ * Decodes the BA_SCHEDULED payload @data straight into the store. The new sces
+ * are scheduled and written to the journal. The payload is checked completely
+ * before the first sce is added, so a malformed payload does not change the plan.
+ * Returns the number of sces in the payload, or -1 if it is malformed.
+ *
+ * @st: the sce store
+ * @data: the payload
+ * @len: length of the payload
+ * @c: the channel the payload was received on
+ * @proto: the bgp protocol
+ */
+int sce_store_decode(struct sce_store * st, const byte * data, uint len, struct channel * c, struct bgp_proto * proto) {
+	int count = sce_cbor_walk(data, len, NULL, NULL, NULL);
+	if (count <= 0) return count;
+
+	struct sce_node ** added = mb_alloc(st->pool, sizeof(struct sce_node *) * count);
+	uint num_added = 0;
+
+	sce_cbor_walk(data, len, st, added, &num_added);
+	sce_store_commit(st, added, num_added, c, proto);
+
+	mb_free(added);
+	return count;
+}
+
+/*
+ * Contact plan files, see the option "sce plan" and the command "sce load".
+ * A plan file contains either the CBOR encoding of a plan, like the payload of
+ * BA_SCHEDULED, or one contact per line in CSV:
+ *
+ *   start,duration,asn1,gw1,asn2,gw2
+ *
+ * The start and the duration are in milliseconds, the start counts from 01.01.2000 (UTC)
+ * like the DTN time in the configuration. The gateways are IPv4 addresses.
+ * Empty lines and everything behind a '#' are ignored.
+ */
+
+static inline const byte * sce_csv_skip(const byte * pos, const byte * end) {
+	while ((pos < end) && ((*pos == ' ') || (*pos == '\t') || (*pos == '\r')))
+		pos++;
+
+	return pos;
+}
+
+static const byte * sce_csv_number(const byte * pos, const byte * end, u64 max, u64 * val) {
+	pos = sce_csv_skip(pos, end);
+	if ((pos == end) || (*pos < '0') || (*pos > '9')) return NULL;
+
+	u64 v = 0;
+	for (; (pos < end) && (*pos >= '0') && (*pos <= '9'); pos++) {
+		uint d = *pos - '0';
+		if (v > (max - d) / 10) return NULL;
+		v = v * 10 + d;
+	}
+
+	*val = v;
+	return pos;
+}
+
+static const byte * sce_csv_ip4(const byte * pos, const byte * end, u64 * val) {
+	u64 v = 0, b;
+
+	for (int i = 0; i < 4; i++) {
+		if (i && ((pos == end) || (*pos++ != '.'))) return NULL;
+		if (!(pos = sce_csv_number(pos, end, 255, &b))) return NULL;
+		v = (v << 8) | b;
+	}
+
+	*val = v;
+	return pos;
+}
+
+static inline const byte * sce_csv_sep(const byte * pos, const byte * end) {
+	pos = sce_csv_skip(pos, end);
+	return ((pos < end) && (*pos == ',')) ? pos + 1 : NULL;
+}
+
+/*
+ * Parses the line from @pos to @end into @e.
+ * Returns 1 for a contact, 0 for an empty line and -1 for a malformed line.
+ */
+static int sce_csv_line(const byte * pos, const byte * end, scheduled_contact_entry * e) {
+	const byte * comment = memchr(pos, '#', end - pos);
+	if (comment) end = comment;
+
+	if (sce_csv_skip(pos, end) == end) return 0;
+
+	u64 v[6];
+	if (!(pos = sce_csv_number(pos, end, ~((u64) 0), &v[0])) || !(pos = sce_csv_sep(pos, end)) ||
+			!(pos = sce_csv_number(pos, end, ~((u64) 0), &v[1])) || !(pos = sce_csv_sep(pos, end)) ||
+			!(pos = sce_csv_number(pos, end, 0xffffffff, &v[2])) || !(pos = sce_csv_sep(pos, end)) ||
+			!(pos = sce_csv_ip4(pos, end, &v[3])) || !(pos = sce_csv_sep(pos, end)) ||
+			!(pos = sce_csv_number(pos, end, 0xffffffff, &v[4])) || !(pos = sce_csv_sep(pos, end)) ||
+			!(pos = sce_csv_ip4(pos, end, &v[5])) || (sce_csv_skip(pos, end) != end))
+		return -1;
+
+	*e = (scheduled_contact_entry) {
+		.start_time = v[0],
+		.duration = v[1],
+		.asn1 = v[2],
+		.gw1 = v[3],
+		.asn2 = v[4],
+		.gw2 = v[5],
+	};
+
+	return 1;
+}
+
+/*
+ * Walks the CSV plan @data like sce_cbor_walk(). Without @st, the plan is only checked.
+ * Returns the number of contacts, or -1 if the line *@line is malformed.
+ */
+static int sce_csv_walk(const byte * data, size_t len, struct sce_store * st, struct sce_node ** added, uint * num_added, uint * line) {
+	const byte * end = data + len;
+	scheduled_contact_entry e;
+	int count = 0;
+
+	*line = 0;
+	for (const byte * pos = data; pos < end; ) {
+		const byte * eol = memchr(pos, '\n', end - pos);
+		if (!eol) eol = end;
+
+		(*line)++;
+		int res = sce_csv_line(pos, eol, &e);
+		if (res < 0) return -1;
+
+		if (res) {
+			struct sce_node * n;
+			if (st && (n = sce_store_add(st, &e)))
+				added[(*num_added)++] = n;
+
+			count++;
+		}
+
+		pos = eol + 1;
+	}
+
+	return count;
+}
+
+/**
+ * Loads the contact plan file @name into the store. The file is mapped and checked
+ * completely before the first contact is added, so a malformed file does not change the plan.
+ * The contacts are added straight to the store, the known ones are skipped by their hash
+ * lookup and only the new ones are scheduled and written to the journal. A file, that did
+ * not change since it was loaded last, is not read again unless @force is set.
+ * Returns the number of added contacts, or -1 on error.
+ *
+ * @st: the sce store
+ * @name: name of the file
+ * @force: load the file even if it did not change
+ * @c: the channel for the routes of the new contacts
+ * @proto: the bgp protocol
+ */
+int sce_store_load_file(struct sce_store * st, const char * name, _Bool force, struct channel * c, struct bgp_proto * proto) {
+	int fd = open(name, O_RDONLY);
+	if (fd < 0) {
+		log(L_ERR "Cannot open SCE plan %s: %m", name);
+		return -1;
+	}
+
+	struct stat fileinfo;
+	if (fstat(fd, &fileinfo) < 0) {
+		log(L_ERR "Cannot stat SCE plan %s: %m", name);
+		close(fd);
+		return -1;
+	}
+
+	u64 stamp[4] = { fileinfo.st_dev, fileinfo.st_ino, fileinfo.st_size,
+		(u64) fileinfo.st_mtim.tv_sec * 1000000000 + fileinfo.st_mtim.tv_nsec };
+
+	if (!force && st->plan_file && !strcmp(st->plan_file, name) && !memcmp(st->plan_stamp, stamp, sizeof(stamp))) {
+		close(fd);
+		return 0;
+	}
+
+	size_t size = fileinfo.st_size;
+	byte * data = size ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+	close(fd);
 
-	u16 num_of_entries = entries->number_of_entries;
+	if (data == MAP_FAILED) {
+		log(L_ERR "Cannot map SCE plan %s: %m", name);
+		return -1;
+	}
 
-	if (num_of_entries == 0) return NULL;
+	// a CBOR plan starts with an array, a CSV plan with a number, a blank or a comment
+	_Bool cbor = size && ((data[0] >> 5) == 4);
+	uint line;
 
-	// defines upper bound for size of CBOR data object
-	// the additional 6 byte are for possible overhead by CBOR,
-	// if all fields reach their max. values
-	u16 size = num_of_entries * (sizeof(scheduled_contact_entry) + 6);
-	unsigned char * buffer = malloc( size );
-	unsigned char * data = buffer;
+	int count = cbor ?
+		sce_cbor_walk(data, size, NULL, NULL, NULL) :
+		sce_csv_walk(data, size, NULL, NULL, NULL, &line);
 
-	data = cbor_write_array(data, size, num_of_entries);
+	if (count < 0) {
+		if (cbor)
+			log(L_ERR "SCE plan %s: Malformed CBOR plan", name);
+		else
+			log(L_ERR "SCE plan %s, line %u: Malformed contact", name, line);
 
-	for (u16 i = 0; i < num_of_entries; i++) {
-		scheduled_contact_entry * e = (entries->entries+i);
+		if (data)
+			munmap(data, size);
 
-		data = cbor_write_array(data, size, 6);
-		data = cbor_write_long(data, size, e->start_time);
-		data = cbor_write_long(data, size, e->duration);
-		data = cbor_write_int(data, size, e->asn1);
-		data = cbor_write_int(data, size, e->gw1);
-		data = cbor_write_int(data, size, e->asn2);
-		data = cbor_write_int(data, size, e->gw2);
+		return -1;
 	}
 
-	*data_size = data - buffer;
+	struct sce_node ** added = mb_alloc(st->pool, sizeof(struct sce_node *) * MAX(count, 1));
+	uint num_added = 0;
+
+	if (cbor)
+		sce_cbor_walk(data, size, st, added, &num_added);
+	else
+		sce_csv_walk(data, size, st, added, &num_added, &line);
+
+	sce_store_commit(st, added, num_added, c, proto);
+	mb_free(added);
+
+	if (data)
+		munmap(data, size);
+
+	// an unchanged file is skipped on the next reconfiguration
+	if (!st->plan_file || strcmp(st->plan_file, name)) {
+		mb_free(st->plan_file);
+		st->plan_file = mb_alloc(st->pool, strlen(name) + 1);
+		strcpy(st->plan_file, name);
+	}
+	memcpy(st->plan_stamp, stamp, sizeof(stamp));
 
-	return buffer;
+	log(L_INFO "Loaded %u new of %d scheduled contacts from %s", num_added, count, name);
+	return num_added;
 }
 
 
@@ -23,11 +23,25 @@
 #include <stdio.h>
 
 #include "nest/route.h"
+#include "lib/resource.h"
+#include "lib/hash.h"
+#include "lib/lists.h"
+#include "lib/buffer.h"
+#include "lib/timer.h"
+#include "lib/event.h"
+#include "lib/unaligned.h"
 
 #define SCES_FILENAME	"sces.bin"
 #define SCE_SIZE	32
 #define DTNEPOCH 946684800000	// milliseconds since UNIX epoch to 01.01.2000 (UTC)
 
+#define SCE_RETENTION_DEFAULT	(3600 S_)	// how long a contact is kept after it ended
+#define SCE_GC_PERIOD		(60 S_)		// interval of the removal of expired contacts
+#define SCE_LOOKAHEAD_DEFAULT	(10 S_)		// how long before a contact its routes are prepared
+#define SCE_PREPARE_MAX		16		// contacts prepared by one run of the work event
+#define SCE_CLOCK_CHECK		(1 S_)		// interval of the check for steps of the real-time clock
+#define SCE_CLOCK_STEP		(10 MS_)	// larger changes of the real-time clock re-anchor the scheduler
+
 /* Extension to specify one scheduled contact entry of a network
  * 	start_time: 	when will the network be reachable			64-Bit [milliseconds since 01.01.2000 (UTC)]
  * 	up_time:		how long will the network be reachable		64-Bit [duration of possible contact in milliseconds]
@@ -51,17 +65,409 @@ typedef struct scheduled_contact_entry {
 
 // set of multiple scheduled_contact_entry
 typedef struct scheduled_contact_entries {
-	u16 number_of_entries;
+	u32 number_of_entries;
 	scheduled_contact_entry *entries;
 } scheduled_contact_entries;
 
-// composite type to pass sce and a channel to access the routing table when timer fires
+/*
+ * Canonical key of a scheduled contact entry.
+ * Both sides of the contact are ordered by (ASN, gateway), so that
+ * symmetric entries (AS1-AS2 and AS2-AS1) share the same key.
+ */
+typedef struct sce_key {
+	u64 start_time;
+	u64 duration;
+	u32 asn_lo;
+	u32 gw_lo;
+	u32 asn_hi;
+	u32 gw_hi;
+} sce_key;
+
+static inline sce_key sce_get_key(const scheduled_contact_entry * e) {
+	_Bool swap = (e->asn1 > e->asn2) || ((e->asn1 == e->asn2) && (e->gw1 > e->gw2));
+
+	return (sce_key) {
+		.start_time = e->start_time,
+		.duration = e->duration,
+		.asn_lo = swap ? e->asn2 : e->asn1,
+		.gw_lo = swap ? e->gw2 : e->gw1,
+		.asn_hi = swap ? e->asn1 : e->asn2,
+		.gw_hi = swap ? e->gw1 : e->gw2,
+	};
+}
+
+static inline u32 sce_key_hash(const sce_key * k) {
+	return mem_hash(k, sizeof(sce_key));
+}
+
+/*
+ * Contact of a route built over scheduled contacts, kept in the generic attribute
+ * EA_GEN_SCE, so filters do not have to parse the AS_PATH: the end of the window,
+ * until which all contacts of the route are open, in milliseconds since
+ * 01.01.2000 (UTC) and both ASNs of the contact, the lower one first.
+ *
+ * data: end (8), asn_lo (4), asn_hi (4)
+ */
+#define SCE_EA_LENGTH	16
+
+static inline _Bool sce_ea_get(const eattr * a, u64 * end, u32 * asn_lo, u32 * asn_hi) {
+	if (!a || (a->u.ptr->length != SCE_EA_LENGTH)) return 0;
+
+	*end = get_u64(a->u.ptr->data);
+	*asn_lo = get_u32(a->u.ptr->data + 8);
+	*asn_hi = get_u32(a->u.ptr->data + 12);
+	return 1;
+}
+
+// remaining milliseconds of the window of the route with the attribute @a, 0 if it has none
+static inline u32 sce_ea_remaining(const eattr * a) {
+	u64 end, now = (u64) (current_real_time() TO_MS) - DTNEPOCH;
+	u32 asn_lo, asn_hi;
+
+	if (!sce_ea_get(a, &end, &asn_lo, &asn_hi) || (end <= now)) return 0;
+
+	return (end - now > 0xffffffff) ? 0xffffffff : (u32) (end - now);
+}
+
+struct sce_event;
+struct sce_stage;
+struct sce_cg;
+
+// counters of one contact, shown by "show sce"
+struct sce_stats {
+	u32 added;			// routes announced when the contact began
+	u32 withdrawn;			// routes withdrawn when the contact ended
+	btime add_time;			// duration of modify_routingtable_add() for the batch of the begin
+	btime remove_time;		// duration of modify_routingtable_remove() for the batch of the end
+	btime latency;			// from the scheduled begin until its routes were announced
+};
+
+// one scheduled contact entry in a sce_set
+struct sce_node {
+	node n;				// in sce_set.list, in insertion order
+	struct sce_node * next;		// next in the hash chain
+	u32 hash;
+	sce_key key;
+	scheduled_contact_entry e;	// the entry as it was learned
+	u32 seq;			// version of the store that added the entry
+	struct sce_event * events[3];	// queued begin, end and preparation of the contact, if any
+	struct sce_stage * stage;	// routes prepared for the begin of the contact, if any
+	struct sce_stats stats;
+};
+
+// set of unique scheduled contact entries, indexed by their canonical key
+struct sce_set {
+	pool * pool;
+	slab * slab;
+	list list;			// all sce_node's in insertion order
+	HASH(struct sce_node) hash;
+};
+
+void sce_set_init(struct sce_set * set, pool * p);
+void sce_set_free(struct sce_set * set);
+struct sce_node * sce_set_find(struct sce_set * set, const scheduled_contact_entry * e);
+struct sce_node * sce_set_add(struct sce_set * set, const scheduled_contact_entry * e);
+void sce_set_remove(struct sce_set * set, struct sce_node * n);
+
+static inline uint sce_set_count(struct sce_set * set) {
+	return set->hash.count;
+}
+
+/*
+ * Index of the adjacent AS pairs in the AS paths of a routing table.
+ * For every AS pair it holds the networks that have a route containing the pair,
+ * so contact events only need to touch these networks instead of the whole table.
+ * The first ASN of a path is paired with SCE_PAIR_START (the local AS).
+ * The index is updated from rte_recalculate() on every route change.
+ */
+#define SCE_PAIR_START	0
+
+struct sce_pair {
+	struct sce_pair * next;		// hash chain
+	u32 asn1;			// asn1 < asn2, or SCE_PAIR_START
+	u32 asn2;
+	u32 hash;
+	list nets;			// sce_pair_net's of networks with routes containing the pair
+};
+
+struct sce_pair_net {
+	node n;				// in sce_pair.nets
+	struct sce_pair_net * next;	// hash chain
+	struct sce_pair * pair;
+	net * net;
+	u32 hash;
+	u32 count;			// number of occurrences of the pair in routes of net
+};
+
+// an AS with all pairs it is a part of
+struct sce_as {
+	struct sce_as * next;		// hash chain
+	u32 asn;
+	BUFFER_(struct sce_pair *) pairs;
+};
+
+struct sce_index {
+	pool * pool;
+	rtable * table;
+	slab * pair_slab;
+	slab * net_slab;
+	slab * as_slab;
+	HASH(struct sce_pair) pairs;
+	HASH(struct sce_pair_net) nets;
+	HASH(struct sce_as) ases;
+	list stages;			// sce_stage's whose routes have to be kept up to date
+};
+
+struct sce_index * sce_index_get(rtable * table);
+void sce_index_update(struct sce_index * idx, net * n, rte * new, rte * old);
+uint sce_index_pair_nets(struct sce_index * idx, u32 asn1, u32 asn2, net *** nets);
+uint sce_index_as_nets(struct sce_index * idx, u32 asn, net *** nets);
+
+// composite type to pass sce and a channel to access the routing table when a contact begins or ends
 typedef struct entry_data {
 	scheduled_contact_entry * sce;
 	struct channel * ch;
 	struct bgp_proto * proto;
+	struct sce_stage * stage;	// routes prepared for the begin of the contact, if any
+	struct sce_stats * stats;	// counters of the contact, if any
 } entry_data;
 
+/*
+ * Routes prepared ahead of a contact.
+ * The AS paths over the contact are computed within the look-ahead window
+ * (option "sce lookahead") and kept per network. Networks whose routes
+ * change afterwards are marked dirty and computed again when the contact
+ * begins, the others are only committed.
+ *
+ * The computation runs on a snapshot of the AS paths of the affected networks.
+ * If threads are available, the snapshot is taken in the main loop, computed
+ * by the SCE worker thread and handed back to the main loop, see sce_worker_queue().
+ * While the stage is busy, only the worker touches it.
+ */
+struct sce_stage_route {
+	struct sce_stage_route * next;
+	rta * tmpl;			// attributes of the template route, referenced once the stage is done
+	eattr attr;			// the new AS_PATH attribute
+};
+
+struct sce_stage_net {
+	struct sce_stage_net * next;	// hash chain
+	net * net;
+	u8 dirty;			// routes of the network changed after the preparation
+	struct sce_stage_route * routes;
+};
+
+// routes of a network when the snapshot was taken
+struct sce_snap_net {
+	net * net;
+	uint num;
+	rta ** tmpls;			// referenced until the stage is done
+	const struct adata ** paths;	// the AS paths of the templates
+};
+
+struct sce_stage {
+	node n;				// in sce_index.stages
+	node wn;			// in the queue or the done list of the worker
+	pool * pool;
+	linpool * lp;			// the stage_net's, stage_route's and AS paths
+	struct sce_index * idx;
+	uint routes;			// number of prepared routes
+	HASH(struct sce_stage_net) nets;
+	scheduled_contact_entry e;	// the contact
+	u32 own;			// the own ASN
+	struct sce_snap_net * snap;	// the snapshot, until the stage is done
+	uint snap_nets;			// number of networks in the snapshot
+	uint snap_pos;			// networks computed so far
+	u8 busy;			// queued or computed by the worker
+	u8 cancelled;			// freed while busy, it is released once the worker is done
+	BUFFER_(net *) touched;		// networks changed while busy
+};
+
+void sce_stage_free(struct sce_stage * stg);
+
+static inline _Bool sce_stage_ready(struct sce_stage * stg) {
+	return stg && !stg->busy;
+}
+
+/*
+ * SCE worker thread, a birdloop like the one of BFD. It computes the queued stages
+ * in chunks of SCE_WORKER_CHUNK networks, so queueing never waits long for it.
+ */
+#define SCE_WORKER_CHUNK	64
+
+_Bool sce_worker_queue(struct sce_stage * stg);
+void sce_worker_sync(void);
+
+/*
+ * Contact plan scheduler.
+ * The begin and end of all contacts are kept in one heap ordered by their time,
+ * a single timer is set to the earliest of them.
+ */
+#define SCE_EV_BEGIN	0
+#define SCE_EV_END	1
+#define SCE_EV_PREPARE	2	// the begin of the look-ahead window
+#define SCE_EV_MAX	3
+
+struct sce_event {
+	u64 when;			// milliseconds since 01.01.2000 (UTC)
+	int index;			// position in the heap
+	u8 type;			// SCE_EV_BEGIN, SCE_EV_END or SCE_EV_PREPARE
+	struct sce_node * node;		// the sce in the store
+	entry_data ed;
+};
+
+// histogram of durations, the buckets are decades from 100 us up to 10 s
+#define SCE_HIST_BUCKETS	7
+
+struct sce_hist {
+	u32 count;
+	btime total;
+	btime max;
+	u32 buckets[SCE_HIST_BUCKETS];
+};
+
+struct sce_sched {
+	pool * pool;
+	slab * slab;
+	timer * timer;
+	timer * clock;			// watches the real-time clock while events are queued
+	btime offset;			// current_real_time() - current_time() the timer was set with
+	u32 steps;			// number of real-time clock steps seen so far
+	u32 fired;			// number of events that fired so far
+	BUFFER_(struct sce_event *) heap;	// heap[1..n], heap[0] is unused
+	BUFFER_(struct sce_event *) due;	// events fired in the current tick
+	BUFFER_(struct sce_node *) pending;	// contacts waiting for the preparation
+	event * prepare;		// low-priority work event preparing the pending contacts
+	u32 prepared;			// number of contacts prepared so far
+	struct sce_hist add_hist;	// durations of the batches of begins
+	struct sce_hist remove_hist;	// durations of the batches of ends
+	struct sce_hist latency_hist;	// activation latencies of the contacts
+};
+
+void sce_sched_init(struct sce_sched * s, pool * p);
+void sce_sched_add_sces(struct sce_sched * s, struct sce_node ** nodes, uint count, struct channel * c, struct bgp_proto * proto);
+void sce_sched_cancel(struct sce_sched * s, struct sce_node * n);
+
+static inline struct sce_event * sce_sched_first(struct sce_sched * s) {
+	return (s->heap.used > 1) ? s->heap.data[1] : NULL;
+}
+
+/*
+ * On-disk journal of the contact plan in SCES_FILENAME.
+ * A header is followed by fixed-size records, all fields in network byte order
+ * and every record protected by a CRC-32. Changes of the plan are appended,
+ * the file is compacted to the current plan when it holds too many stale records.
+ *
+ * header: magic (4), version (2), record size (2), reserved (4), crc (4)
+ * record: type (1), reserved (3), start_time (8), duration (8),
+ *         asn1 (4), gw1 (4), asn2 (4), gw2 (4), crc (4)
+ */
+#define SCE_JOURNAL_MAGIC	0x42534345	// "BSCE"
+#define SCE_JOURNAL_VERSION	1
+#define SCE_JOURNAL_HDR_SIZE	16
+#define SCE_JOURNAL_REC_SIZE	40
+#define SCE_JOURNAL_MIN_COMPACT	1024	// stale records tolerated before compaction
+
+#define SCE_JR_ADD	1
+#define SCE_JR_DEL	2
+
+/*
+ * Interval index of the contact windows [start_time, start_time + duration).
+ * The windows of the plan are sorted by their begin and form an implicit binary
+ * search tree, in which every node holds the latest end of its subtree.
+ * Stabbing and overlap queries take O(log n + k) for k results.
+ * The index is rebuilt on first use after the plan changed.
+ */
+struct sce_iv {
+	u64 start;
+	u64 end;
+	u64 max;			// latest end in the subtree
+	struct sce_node * node;
+};
+
+struct sce_itree {
+	BUFFER_(struct sce_iv) ivs;	// sorted by start, the leaves at even positions
+	int levels;			// level of the root, -1 if the tree is empty
+	u32 version;			// version of the plan the index was built from
+};
+
+/*
+ * Resident contact plan, shared by all BGP instances.
+ * The plan is loaded from SCES_FILENAME once and afterwards changed in memory
+ * and in the journal. Contacts are removed when they ended longer than the
+ * retention window (option "sce retention") ago.
+ * The CBOR encoding of the plan (payload of BA_SCHEDULED) is cached and
+ * rebuilt lazily when the version of the plan differs from the encoded one.
+ */
+struct sce_store {
+	pool *pool;
+	struct sce_set set;		// all known valid scheduled contact entries
+	struct sce_sched sched;		// begin and end of the contacts in the set
+	u32 version;			// incremented on every change of the set
+	u32 cbor_version;		// version of the set encoded in cbor
+	byte *cbor;			// pre-encoded BA_SCHEDULED payload
+	uint cbor_len;
+	uint cbor_size;
+	int journal_fd;			// SCES_FILENAME opened for appending, or -1
+	uint journal_records;		// number of records in the journal
+	struct sce_cg * cg;		// contact graph of the plan, built on first use
+	struct sce_itree itree;		// windows of the contacts of the plan, built on first use
+	_Bool restarted;		// the plan was handed over to the scheduler, see sce_store_restart()
+	timer * gc_timer;		// removes expired contacts periodically
+	u32 expired;			// number of expired contacts removed so far
+	char * plan_file;		// plan file loaded last by sce_store_load_file(), or NULL
+	u64 plan_stamp[4];		// its device, inode, size and modification time
+};
+
+/*
+ * Contact graph of the plan.
+ * Every AS of the plan is a vertex and every sce an edge between its two ASes,
+ * that can only be used during the contact. An earliest-arrival search (Dijkstra)
+ * from the local AS finds paths over chains of present and future contacts.
+ * The paths are cached per destination AS until the plan changes or a contact
+ * begins or ends.
+ */
+#define SCE_CG_NEVER	(~(u64) 0)
+
+struct sce_cg_as {
+	struct sce_cg_as * next;	// hash chain
+	u32 asn;
+	int index;			// position in the search heap, 0 if not queued
+	u8 done;			// the earliest arrival is final
+	u64 arrival;			// earliest arrival, SCE_CG_NEVER if unreachable
+	struct sce_cg_as * prev;	// previous AS on the path
+	struct sce_node * via;		// contact from prev to this AS
+	BUFFER_(struct sce_node *) contacts;	// all contacts of the AS
+};
+
+// path from the local AS to dest over a chain of contacts
+struct sce_cg_route {
+	struct sce_cg_route * next;	// hash chain
+	u32 dest;
+	u64 arrival;			// earliest arrival at dest
+	uint len;			// number of ASNs in asns, the first is the local AS
+	struct sce_node ** hops;	// the contacts between the ASNs, len - 1
+	u32 asns[0];
+};
+
+struct sce_cg {
+	pool * pool;
+	linpool * lp;			// cached routes, flushed on invalidation
+	slab * as_slab;
+	u32 own;			// the local ASN, source of the search
+	u32 version;			// version of the plan the graph was built from
+	u32 fired;			// sce_sched.fired when the search was done
+	u64 now;			// time of the search
+	_Bool searched;			// the search was done
+	HASH(struct sce_cg_as) ases;
+	HASH(struct sce_cg_route) routes;
+	BUFFER_(struct sce_cg_as *) heap;
+};
+
+struct sce_cg * sce_cg_get(struct sce_store * st, u32 own, u64 now);
+struct sce_cg_route * sce_cg_route_get(struct sce_cg * cg, u32 dest);
+_Bool sce_cg_route_open(struct sce_cg_route * r, u64 now);
+
 // composite type to pass sce and an channel to access the routingtable when timer fires
 typedef struct attrs_holding {
 	struct eattr * attrs;
@@ -74,12 +480,14 @@ _Bool path_contains_as_pair(scheduled_contact_entry * entry, eattr * as_patah_at
 // should be deleted later, only for debugging:
 void print_nexthop(rte * rt);
 
-void modify_routingtable_add(entry_data *ed);
-void modify_routingtable_remove(entry_data *ed);
+void sce_scratch_init(pool * p);
+void sce_scratch_flush(void);
+void modify_routingtable_add(entry_data **eds, uint count);
+void modify_routingtable_remove(entry_data **eds, uint count);
 attrs_holding * insert_sce_in_path(scheduled_contact_entry * entry, struct eattr * attr, rte * routes, u32 mypublicasn);
 attrs_holding * remove_duplicates(attrs_holding * attr_h);
 _Bool check_equal_path(u32 * path1, u8 len_path1, u32 * path2, u8 len_path2);
-u32 * get_as_path(struct eattr * as_path_attr);
+_Bool sce_path_same_neighbor(const struct adata * path1, const struct adata * path2);
 u32 * extend_as_path(u32 * as_path, u8 index, u8 num_segments, u32 asn);
 u32 * kick_first_segment(u32 * as_path, u8 num_segments);
 u32 * add_first_segment(u32 * as_path, u8 num_segments, u32 asn);
@@ -92,27 +500,63 @@ void print_as_path_rt(rte * r);
 void print_rte_infos(rte * r);
 ea_list * add_nexthop_attribute(struct nexthop * nh, ea_list * eal);
 rte * copy_rte_and_insert_as_path(rte ** rt, struct eattr * new_as_path, struct bgp_proto * p, scheduled_contact_entry * entry);
-void add_next_hop(rta * att, struct bgp_proto * p, scheduled_contact_entry * entry);
+_Bool add_next_hop(rta * att, struct bgp_proto * p, scheduled_contact_entry * entry);
 
-_Bool is_unique_route(rte * route, rtable * table, u32 * ipv4_address);
+_Bool is_unique_route(rte * route, net * n);
 
 scheduled_contact_entries * find_new_sces(scheduled_contact_entries * new, scheduled_contact_entries * existing);
-void register_sces(scheduled_contact_entries * entries, struct channel *c, struct bgp_proto * proto);
-timer * register_timer(void (*hook)(struct timer *), u64 when, scheduled_contact_entry * entry_data, struct channel *c, struct bgp_proto * proto);
-void contact_begin(timer *t);
-void contact_end(timer *t);
-u64 convert_unixtime_to_secfromnow(u64 relative_time);
+void contact_begin(entry_data **eds, uint count);
+void contact_end(entry_data **eds, uint count);
 
 _Bool check_equal_sces(scheduled_contact_entry * entry1, scheduled_contact_entry * entry2);
 scheduled_contact_entries * merge_sces(scheduled_contact_entries *entries1, scheduled_contact_entries *entries2);
 void print_sces(scheduled_contact_entries *entries);
 
 void store_sces(scheduled_contact_entries *entries, struct channel *c, struct bgp_proto * proto);
-void store_sce(FILE *fd, scheduled_contact_entry *entry);
+struct channel * sce_channel(struct proto * P);
 //void write_15_byte(FILE *fd, byte *data);
-scheduled_contact_entries * load_sces(void);
 
 unsigned char * get_sces_cbor(unsigned int * data_size);
+unsigned char * get_sces_cbor_since(u32 since, uint max, linpool * lp, unsigned int * data_size, u32 * upto);
+int sce_store_decode(struct sce_store * st, const byte * data, uint len, struct channel * c, struct bgp_proto * proto);
+int sce_store_load_file(struct sce_store * st, const char * name, _Bool force, struct channel * c, struct bgp_proto * proto);
+
+struct sce_store * sce_store_get(void);
+struct sce_node * sce_store_add(struct sce_store * st, const scheduled_contact_entry * entry);
+void sce_store_remove(struct sce_store * st, struct sce_node * n);
+uint sce_store_overlaps(struct sce_store * st, u64 start, u64 end, struct sce_node *** nodes);
+struct sce_node * sce_store_pair_open(struct sce_store * st, const scheduled_contact_entry * e, u64 at);
+uint sce_store_expire(struct sce_store * st, u64 now);
+void sce_store_commit(struct sce_store * st, struct sce_node ** added, uint num_added, struct channel * c, struct bgp_proto * proto);
+void sce_store_restart(struct sce_store * st, struct channel * c, struct bgp_proto * proto);
+void sce_store_reopen(struct sce_store * st, struct channel * c);
+void sce_store_unbind(struct sce_store * st, struct channel * c);
+void sce_store_save(struct sce_store * st);
+void sce_journal_append(struct sce_store * st, struct sce_node ** nodes, uint count, u8 type);
+
+/*
+ * CLI command "show sce [active|pending|expired] [as <num>]"
+ */
+#define SCE_SHOW_ALL		0
+#define SCE_SHOW_ACTIVE		1
+#define SCE_SHOW_PENDING	2
+#define SCE_SHOW_EXPIRED	3
+
+struct sce_show_data {
+	int state;			// SCE_SHOW_*
+	u32 asn;			// only contacts of this AS, 0 for all
+	struct sce_node * next;		// next contact to show
+	u32 last;			// seq of the last visited contact
+	u32 version;			// version of the store, when next was taken
+	uint shown;			// number of shown contacts
+};
+
+void sce_show(struct sce_show_data * d);
+
+/*
+ * CLI command "sce load <file>"
+ */
+void sce_load(const char * name);
 
 /*
  * Functions for CBOR support.
@@ -0,0 +1,1618 @@
+/*
+ *	BIRD -- Scheduled Contact Entries Tests
+ *
+ *	Can be freely distributed and used under the terms of the GNU GPL.
+ */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "test/birdtest.h"
+#include "test/bt-utils.h"
+
+#include "nest/route.h"
+#include "nest/attrs.h"
+#include "nest/protocol.h"
+#include "lib/resource.h"
+#include "lib/unaligned.h"
+#include "proto/bgp/bgp.h"
+#include "proto/bgp/sce_extension.h"
+#include "proto/mrt/mrt.h"
+
+/*
+ * The benchmarks fail if an operation takes longer than SCE_BENCH_BASE plus
+ * SCE_BENCH_PER_ENTRY for each entry. Both are far above the expected times,
+ * they only catch regressions like a quadratic algorithm on large plans.
+ */
+#define SCE_BENCH_BASE		(200 MS_)
+#define SCE_BENCH_PER_ENTRY	10		/* us */
+#define SCE_BENCH_TIMEOUT	60		/* s */
+
+#define SCE_BENCH_LIMIT(n)	(SCE_BENCH_BASE + (btime) (n) * SCE_BENCH_PER_ENTRY)
+
+static scheduled_contact_entry
+sce(u64 start, u64 duration, u32 asn1, u32 gw1, u32 asn2, u32 gw2)
+{
+  return (scheduled_contact_entry) {
+    .start_time = start,
+    .duration = duration,
+    .asn1 = asn1,
+    .gw1 = gw1,
+    .asn2 = asn2,
+    .gw2 = gw2,
+  };
+}
+
+static u64
+sce_test_now(void)
+{
+  return (u64) (current_real_time() TO_MS) - DTNEPOCH;
+}
+
+static btime
+sce_test_clock(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec S + ts.tv_nsec NS;
+}
+
+static char sce_test_dir[PATH_MAX];
+
+/* Moves the test into an empty directory, the store keeps its journal in the working directory */
+static void
+sce_test_chdir(void)
+{
+  const char *tmp = getenv("TMPDIR");
+  bsnprintf(sce_test_dir, sizeof(sce_test_dir), "%s/bird-sce-XXXXXX", (tmp && *tmp) ? tmp : "/tmp");
+  bt_assert(mkdtemp(sce_test_dir) && !chdir(sce_test_dir));
+}
+
+/* Removes the directory of sce_test_chdir() with the files the test left there */
+static void
+sce_test_rmdir(void)
+{
+  DIR *d = opendir(sce_test_dir);
+  struct dirent *de;
+
+  while (d && (de = readdir(d)))
+    if (strcmp(de->d_name, ".") && strcmp(de->d_name, ".."))
+      unlinkat(dirfd(d), de->d_name, 0);
+
+  if (d)
+    closedir(d);
+
+  bt_assert(!chdir("/") && !rmdir(sce_test_dir));
+}
+
+/* A store which is not connected to the journal and to the global plan */
+static void
+sce_test_store_init(struct sce_store *st)
+{
+  memset(st, 0, sizeof(struct sce_store));
+  st->pool = rp_new(&root_pool, "Test store");
+  st->journal_fd = -1;
+  sce_set_init(&st->set, st->pool);
+  sce_sched_init(&st->sched, st->pool);
+}
+
+/* Distinct contacts starting in one day from now */
+static scheduled_contact_entry *
+sce_test_entries(uint num, uint first)
+{
+  scheduled_contact_entry *e = xmalloc(num * sizeof(scheduled_contact_entry));
+  u64 start = sce_test_now() + 86400000;
+
+  for (uint i = 0; i < num; i++)
+    e[i] = sce(start + (first + i) % 1000, 60000, 65000 + (first + i) / 1000, 0x0a000001, 64512, 0x0a000002);
+
+  return e;
+}
+
+/* A route with an AS_PATH consisting of one AS_SEQUENCE segment */
+static rte *
+sce_test_route(linpool *lp, rte *next, const u32 *asns, uint len)
+{
+  struct adata *ad = lp_alloc(lp, sizeof(struct adata) + 2 + 4 * len);
+  ad->length = 2 + 4 * len;
+  ad->data[0] = AS_PATH_SEQUENCE;
+  ad->data[1] = len;
+
+  for (uint i = 0; i < len; i++)
+    put_u32(ad->data + 2 + 4 * i, asns[i]);
+
+  ea_list *eal = lp_allocz(lp, sizeof(ea_list) + sizeof(eattr));
+  eal->count = 1;
+  eal->attrs[0].id = EA_CODE(PROTOCOL_BGP, BA_AS_PATH);
+  eal->attrs[0].type = EAF_TYPE_AS_PATH;
+  eal->attrs[0].u.ptr = ad;
+
+  rta *a = lp_allocz(lp, sizeof(rta));
+  a->eattrs = eal;
+
+  rte *e = lp_allocz(lp, sizeof(rte));
+  e->attrs = a;
+  e->next = next;
+
+  return e;
+}
+
+static int
+sce_test_path_is(eattr *a, const u32 *asns, uint len)
+{
+  if ((a->u.ptr->length != 2 + 4 * len) || (a->u.ptr->data[1] != len))
+    return 0;
+
+  for (uint i = 0; i < len; i++)
+    if (get_u32(a->u.ptr->data + 2 + 4 * i) != asns[i])
+      return 0;
+
+  return 1;
+}
+
+
+static int
+t_check_equal_sces(void)
+{
+  resource_init();
+
+  scheduled_contact_entry a = sce(1000, 50, 1, 11, 2, 22);
+  scheduled_contact_entry b = sce(1000, 50, 2, 22, 1, 11);
+
+  bt_assert(check_equal_sces(&a, &a));
+  bt_assert(check_equal_sces(&a, &b));
+  bt_assert(check_equal_sces(&b, &a));
+
+  scheduled_contact_entry c[] = {
+    sce(1001, 50, 1, 11, 2, 22),
+    sce(1000, 51, 1, 11, 2, 22),
+    sce(1000, 50, 3, 11, 2, 22),
+    sce(1000, 50, 1, 12, 2, 22),
+    sce(1000, 50, 1, 11, 3, 22),
+    sce(1000, 50, 1, 11, 2, 23),
+    sce(1000, 50, 2, 11, 1, 22),
+  };
+
+  for (uint i = 0; i < ARRAY_SIZE(c); i++)
+    bt_assert_msg(!check_equal_sces(&a, &c[i]), "Entry %u must differ", i);
+
+  return 1;
+}
+
+static int
+t_find_new_sces(void)
+{
+  resource_init();
+
+  scheduled_contact_entry a[] = {
+    sce(1000, 50, 1, 11, 2, 22),
+    sce(2000, 50, 1, 11, 3, 33),
+    sce(3000, 50, 2, 22, 3, 33),
+  };
+  scheduled_contact_entry b[] = {
+    sce(1000, 50, 2, 22, 1, 11),	/* a[0] */
+    sce(4000, 50, 1, 11, 4, 44),
+    sce(3000, 50, 2, 22, 3, 33),	/* a[2] */
+    sce(4000, 50, 4, 44, 1, 11),	/* b[1] */
+    sce(5000, 50, 1, 11, 4, 44),
+  };
+
+  scheduled_contact_entries existing = { ARRAY_SIZE(a), a };
+  scheduled_contact_entries new = { ARRAY_SIZE(b), b };
+  scheduled_contact_entries empty = { 0, NULL };
+
+  scheduled_contact_entries *n = find_new_sces(&new, &existing);
+  bt_assert(n->number_of_entries == 2);
+  bt_assert(!memcmp(&n->entries[0], &b[1], sizeof(scheduled_contact_entry)));
+  bt_assert(!memcmp(&n->entries[1], &b[4], sizeof(scheduled_contact_entry)));
+  free(n->entries);
+  free(n);
+
+  n = find_new_sces(&existing, &existing);
+  bt_assert(n->number_of_entries == 0);
+  free(n->entries);
+  free(n);
+
+  n = find_new_sces(&existing, &empty);
+  bt_assert(n->number_of_entries == ARRAY_SIZE(a));
+  bt_assert(!memcmp(n->entries, a, sizeof(a)));
+  free(n->entries);
+  free(n);
+
+  n = find_new_sces(&empty, &existing);
+  bt_assert(n->number_of_entries == 0);
+  free(n->entries);
+  free(n);
+
+  return 1;
+}
+
+static int
+t_merge_sces(void)
+{
+  resource_init();
+
+  scheduled_contact_entry a[] = {
+    sce(1000, 50, 1, 11, 2, 22),
+    sce(2000, 50, 1, 11, 3, 33),
+    sce(1000, 50, 2, 22, 1, 11),	/* a[0] */
+  };
+  scheduled_contact_entry b[] = {
+    sce(3000, 50, 2, 22, 3, 33),
+    sce(2000, 50, 3, 33, 1, 11),	/* a[1] */
+    sce(4000, 50, 1, 11, 4, 44),
+  };
+
+  scheduled_contact_entries x = { ARRAY_SIZE(a), a };
+  scheduled_contact_entries y = { ARRAY_SIZE(b), b };
+  scheduled_contact_entries empty = { 0, NULL };
+
+  scheduled_contact_entries *m = merge_sces(&x, &y);
+  bt_assert(m->number_of_entries == 4);
+  bt_assert(!memcmp(&m->entries[0], &a[0], sizeof(scheduled_contact_entry)));
+  bt_assert(!memcmp(&m->entries[1], &a[1], sizeof(scheduled_contact_entry)));
+  bt_assert(!memcmp(&m->entries[2], &b[0], sizeof(scheduled_contact_entry)));
+  bt_assert(!memcmp(&m->entries[3], &b[2], sizeof(scheduled_contact_entry)));
+  free(m->entries);
+  free(m);
+
+  m = merge_sces(&y, &x);
+  bt_assert(m->number_of_entries == 4);
+  bt_assert(!memcmp(&m->entries[0], &b[0], sizeof(scheduled_contact_entry)));
+  bt_assert(!memcmp(&m->entries[3], &a[0], sizeof(scheduled_contact_entry)));
+  free(m->entries);
+  free(m);
+
+  m = merge_sces(&empty, &empty);
+  bt_assert(m->number_of_entries == 0);
+  free(m->entries);
+  free(m);
+
+  return 1;
+}
+
+static int
+t_path_contains_as_pair(void)
+{
+  resource_init();
+  linpool *lp = lp_new_default(&root_pool);
+
+  const u32 p[] = { 1, 2, 6, 3 };
+  rte *r = sce_test_route(lp, NULL, p, ARRAY_SIZE(p));
+  eattr *a = get_as_path_attr(r);
+  bt_assert(a);
+
+  scheduled_contact_entry e = sce(1000, 50, 2, 22, 6, 66);
+  bt_assert(path_contains_as_pair(&e, a, 100));
+
+  /* Both directions of a contact are usable */
+  e = sce(1000, 50, 6, 66, 2, 22);
+  bt_assert(path_contains_as_pair(&e, a, 100));
+
+  /* The own ASN is the first hop of every path */
+  e = sce(1000, 50, 100, 10, 1, 11);
+  bt_assert(path_contains_as_pair(&e, a, 100));
+  bt_assert(!path_contains_as_pair(&e, a, 200));
+
+  /* The ASNs must be adjacent */
+  e = sce(1000, 50, 2, 22, 3, 33);
+  bt_assert(!path_contains_as_pair(&e, a, 100));
+
+  e = sce(1000, 50, 100, 10, 2, 22);
+  bt_assert(!path_contains_as_pair(&e, a, 100));
+
+  e = sce(1000, 50, 7, 77, 8, 88);
+  bt_assert(!path_contains_as_pair(&e, a, 100));
+
+  /* Pairs span segments, but the members of an AS_SET are no hops */
+  byte segs[] = { AS_PATH_SEQUENCE, 2, 0, 0, 0, 1, 0, 0, 0, 2, AS_PATH_SEQUENCE, 2, 0, 0, 0, 6, 0, 0, 0, 3 };
+  struct adata *ad = lp_alloc(lp, sizeof(struct adata) + sizeof(segs));
+  ad->length = sizeof(segs);
+  memcpy(ad->data, segs, sizeof(segs));
+  a->u.ptr = ad;
+
+  e = sce(1000, 50, 2, 22, 6, 66);
+  bt_assert(path_contains_as_pair(&e, a, 100));
+
+  ad->data[0] = AS_PATH_SET;
+  bt_assert(!path_contains_as_pair(&e, a, 100));
+
+  e = sce(1000, 50, 100, 10, 1, 11);
+  bt_assert(!path_contains_as_pair(&e, a, 100));
+
+  e = sce(1000, 50, 6, 66, 3, 33);
+  bt_assert(path_contains_as_pair(&e, a, 100));
+
+  /* The neighbor AS is the first ASN of an AS_SEQUENCE */
+  const u32 q1[] = { 1, 9 };
+  const u32 q2[] = { 2, 9 };
+  const struct adata *n1 = get_as_path_attr(sce_test_route(lp, NULL, q1, ARRAY_SIZE(q1)))->u.ptr;
+  const struct adata *n2 = get_as_path_attr(sce_test_route(lp, NULL, q2, ARRAY_SIZE(q2)))->u.ptr;
+
+  bt_assert(!sce_path_same_neighbor(ad, n1));
+  ad->data[0] = AS_PATH_SEQUENCE;
+  bt_assert(sce_path_same_neighbor(ad, n1) && sce_path_same_neighbor(n1, ad));
+  bt_assert(!sce_path_same_neighbor(ad, n2));
+
+  sce_scratch_flush();
+  rfree(lp);
+
+  return 1;
+}
+
+static int
+t_insert_sce_in_path(void)
+{
+  resource_init();
+  linpool *lp = lp_new_default(&root_pool);
+
+  const u32 p1[] = { 1, 2, 3 };
+  const u32 p2[] = { 5, 6, 3 };
+  const u32 p3[] = { 7, 6, 8, 3 };
+
+  rte *r2 = sce_test_route(lp, NULL, p2, ARRAY_SIZE(p2));
+  rte *r1 = sce_test_route(lp, r2, p1, ARRAY_SIZE(p1));
+  eattr *a = get_as_path_attr(r1);
+
+  /* Contact 2 - 6 shortcuts the path of r1 with the tail of r2 */
+  scheduled_contact_entry e = sce(1000, 50, 2, 22, 6, 66);
+  attrs_holding *h = insert_sce_in_path(&e, a, r1, 100);
+  const u32 x1[] = { 1, 2, 6, 3 };
+  bt_assert(h && h->num_of_new == 1);
+  bt_assert(h && sce_test_path_is(&h->attrs[0], x1, ARRAY_SIZE(x1)));
+
+  /* The order of the ASNs in the entry does not matter */
+  e = sce(1000, 50, 6, 66, 2, 22);
+  h = insert_sce_in_path(&e, a, r1, 100);
+  bt_assert(h && h->num_of_new == 1);
+  bt_assert(h && sce_test_path_is(&h->attrs[0], x1, ARRAY_SIZE(x1)));
+
+  /* Every route through the other ASN gives a tail */
+  rte *r3 = sce_test_route(lp, r1, p3, ARRAY_SIZE(p3));
+  h = insert_sce_in_path(&e, a, r3, 100);
+  const u32 x3[] = { 1, 2, 6, 8, 3 };
+  bt_assert(h && h->num_of_new == 2);
+  bt_assert(h && (sce_test_path_is(&h->attrs[0], x1, ARRAY_SIZE(x1)) || sce_test_path_is(&h->attrs[1], x1, ARRAY_SIZE(x1))));
+  bt_assert(h && (sce_test_path_is(&h->attrs[0], x3, ARRAY_SIZE(x3)) || sce_test_path_is(&h->attrs[1], x3, ARRAY_SIZE(x3))));
+
+  /* No path through the contact exists */
+  e = sce(1000, 50, 2, 22, 9, 99);
+  bt_assert(!insert_sce_in_path(&e, a, r1, 100));
+
+  e = sce(1000, 50, 8, 88, 9, 99);
+  bt_assert(!insert_sce_in_path(&e, a, r1, 100));
+
+  /* The contact is already part of the path */
+  e = sce(1000, 50, 2, 22, 3, 33);
+  bt_assert(!insert_sce_in_path(&e, a, r1, 100));
+
+  /* Paths with a single ASN are not extended */
+  const u32 p4[] = { 6 };
+  rte *r4 = sce_test_route(lp, r2, p4, ARRAY_SIZE(p4));
+  e = sce(1000, 50, 6, 66, 5, 55);
+  bt_assert(!insert_sce_in_path(&e, get_as_path_attr(r4), r4, 100));
+
+  sce_scratch_flush();
+  rfree(lp);
+
+  return 1;
+}
+
+static int
+t_remove_duplicates(void)
+{
+  resource_init();
+
+  /* build_attr() drops the first ASN, it is our own */
+  u32 p[][4] = { { 100, 1, 2, 3 }, { 100, 4, 5, 6 }, { 100, 1, 2, 3 }, { 100, 1, 2, 7 }, { 100, 4, 5, 6 } };
+  eattr attrs[ARRAY_SIZE(p)];
+  for (uint i = 0; i < ARRAY_SIZE(p); i++)
+    attrs[i] = *build_attr(p[i], 4);
+
+  /* Identical paths share their data */
+  bt_assert(attrs[0].u.ptr == attrs[2].u.ptr);
+  bt_assert(attrs[1].u.ptr == attrs[4].u.ptr);
+  bt_assert(attrs[0].u.ptr != attrs[3].u.ptr);
+
+  attrs_holding h = { .attrs = attrs, .num_of_new = ARRAY_SIZE(p) };
+  bt_assert(remove_duplicates(&h) == &h);
+  bt_assert(h.num_of_new == 3);
+
+  const u32 x0[] = { 1, 2, 3 }, x1[] = { 4, 5, 6 }, x2[] = { 1, 2, 7 };
+  bt_assert(sce_test_path_is(&attrs[0], x0, ARRAY_SIZE(x0)));
+  bt_assert(sce_test_path_is(&attrs[1], x1, ARRAY_SIZE(x1)));
+  bt_assert(sce_test_path_is(&attrs[2], x2, ARRAY_SIZE(x2)));
+
+  /* Running again finds no more duplicates */
+  remove_duplicates(&h);
+  bt_assert(h.num_of_new == 3);
+
+  /* Paths not built by build_attr() are found as well */
+  linpool *lp = lp_new_default(&root_pool);
+  rte *r = sce_test_route(lp, NULL, x2, ARRAY_SIZE(x2));
+  attrs[3] = *get_as_path_attr(r);
+  h.num_of_new = 4;
+  remove_duplicates(&h);
+  bt_assert(h.num_of_new == 3);
+
+  sce_scratch_flush();
+  rfree(lp);
+
+  return 1;
+}
+
+#define SCE_TEST_THREADS 4
+
+static void *
+sce_test_thread(void *arg)
+{
+  rte *r1 = arg;
+  pool *p = rp_new(NULL, "Test thread");
+  sce_scratch_init(p);
+
+  const u32 x1[] = { 1, 2, 6, 3 };
+  scheduled_contact_entry e = sce(1000, 50, 2, 22, 6, 66);
+  long ok = 1;
+
+  for (int i = 0; i < 10000; i++)
+  {
+    attrs_holding *h = insert_sce_in_path(&e, get_as_path_attr(r1), r1, 100);
+    ok &= h && (h->num_of_new == 1) && sce_test_path_is(&h->attrs[0], x1, ARRAY_SIZE(x1));
+    sce_scratch_flush();
+  }
+
+  rfree(p);
+  return (void *) ok;
+}
+
+static int
+t_scratch_threads(void)
+{
+  resource_init();
+  linpool *lp = lp_new_default(&root_pool);
+
+  const u32 p1[] = { 1, 2, 3 };
+  const u32 p2[] = { 5, 6, 3 };
+  rte *r2 = sce_test_route(lp, NULL, p2, ARRAY_SIZE(p2));
+  rte *r1 = sce_test_route(lp, r2, p1, ARRAY_SIZE(p1));
+
+  /* Every thread computes paths in its own scratch memory */
+  pthread_t threads[SCE_TEST_THREADS];
+  for (int i = 0; i < SCE_TEST_THREADS; i++)
+    bt_assert(!pthread_create(&threads[i], NULL, sce_test_thread, r1));
+
+  void *ok = sce_test_thread(r1);
+  bt_assert(ok);
+
+  for (int i = 0; i < SCE_TEST_THREADS; i++)
+  {
+    bt_assert(!pthread_join(threads[i], &ok));
+    bt_assert(ok);
+  }
+
+  rfree(lp);
+  return 1;
+}
+
+/* A stage with a snapshot of @num networks, all with the routes @r1 and @r2 */
+static struct sce_stage *
+sce_test_stage(linpool *lp, uint num, rte *r1, rte *r2)
+{
+  pool *p = rp_new(&root_pool, "Test stage");
+  struct sce_stage *stg = mb_allocz(p, sizeof(struct sce_stage));
+  stg->pool = p;
+  stg->lp = lp_new_default(p);
+  HASH_INIT(stg->nets, p, 6);
+  stg->e = sce(1000, 50, 2, 22, 6, 66);
+  stg->own = 100;
+
+  stg->snap = lp_allocz(lp, num * sizeof(struct sce_snap_net));
+  stg->snap_nets = num;
+
+  for (uint i = 0; i < num; i++)
+  {
+    struct sce_snap_net *sn = &stg->snap[i];
+    sn->net = lp_allocz(lp, sizeof(net));
+    sn->num = 2;
+    sn->tmpls = lp_alloc(lp, 2 * sizeof(rta *));
+    sn->paths = lp_alloc(lp, 2 * sizeof(struct adata *));
+
+    sn->tmpls[0] = rta_clone(r1->attrs);
+    sn->tmpls[1] = rta_clone(r2->attrs);
+    sn->paths[0] = get_as_path_attr(r1)->u.ptr;
+    sn->paths[1] = get_as_path_attr(r2)->u.ptr;
+  }
+
+  stg->busy = 1;
+  return stg;
+}
+
+static int
+t_worker(void)
+{
+  bt_bird_init();
+  linpool *lp = lp_new_default(&root_pool);
+
+  const u32 p1[] = { 1, 2, 3 };
+  const u32 p2[] = { 5, 6, 3 };
+  rte *r2 = sce_test_route(lp, NULL, p2, ARRAY_SIZE(p2));
+  rte *r1 = sce_test_route(lp, r2, p1, ARRAY_SIZE(p1));
+  r1->attrs->uc = r2->attrs->uc = 1;
+
+  /* More networks than in one chunk of the worker */
+  uint num = 3 * SCE_WORKER_CHUNK + 1;
+  struct sce_stage *stg = sce_test_stage(lp, num, r1, r2);
+  bt_assert(r1->attrs->uc == num + 1);
+
+#ifdef CONFIG_BFD
+  bt_assert(sce_worker_queue(stg));
+  sce_worker_sync();
+#else
+  bt_assert(!sce_worker_queue(stg));
+  return 1;
+#endif
+
+  /* Both routes are extended by the contact, each one with the tail of the other */
+  bt_assert(!stg->busy && !stg->snap);
+  bt_assert_msg(stg->routes == 2 * num, "routes %u", stg->routes);
+  bt_assert(r1->attrs->uc == num + 1 && r2->attrs->uc == num + 1);
+
+  const u32 x1[] = { 1, 2, 6, 3 };
+  const u32 x2[] = { 5, 6, 2, 3 };
+  HASH_WALK(stg->nets, next, sn)
+  {
+    bt_assert(sn->routes && sn->routes->next && !sn->routes->next->next && !sn->dirty);
+
+    for (struct sce_stage_route *sr = sn->routes; sr; sr = sr->next)
+      bt_assert((sr->tmpl == r1->attrs) ? sce_test_path_is(&sr->attr, x1, ARRAY_SIZE(x1)) :
+		(sr->tmpl == r2->attrs) && sce_test_path_is(&sr->attr, x2, ARRAY_SIZE(x2)));
+  }
+  HASH_WALK_END;
+
+  sce_stage_free(stg);
+  bt_assert(r1->attrs->uc == 1 && r2->attrs->uc == 1);
+
+  /* A stage freed while it is busy is released by the worker */
+  stg = sce_test_stage(lp, num, r1, r2);
+  sce_worker_queue(stg);
+  sce_stage_free(stg);
+  sce_worker_sync();
+  bt_assert(r1->attrs->uc == 1 && r2->attrs->uc == 1);
+
+  rfree(lp);
+  return 1;
+}
+
+static int
+t_cbor_roundtrip(void)
+{
+  resource_init();
+  timer_init();
+  proto_pool = &root_pool;
+  sce_test_chdir();
+
+  struct sce_store *st = sce_store_get();
+  uint len = 0;
+  bt_assert(!get_sces_cbor(&len));
+
+  scheduled_contact_entry *e = sce_test_entries(100, 0);
+  for (uint i = 0; i < 100; i++)
+    bt_assert(sce_store_add(st, &e[i]));
+
+  byte *data = get_sces_cbor(&len);
+  bt_assert(data && (len > 0));
+
+  struct sce_store dst;
+  sce_test_store_init(&dst);
+  bt_assert(sce_store_decode(&dst, data, len, NULL, NULL) == 100);
+  bt_assert(sce_set_count(&dst.set) == 100);
+
+  /* Both stores keep the entries in the order they were added */
+  struct sce_node *n, *m = HEAD(dst.set.list);
+  WALK_LIST(n, st->set.list)
+  {
+    bt_assert(!memcmp(&n->e, &m->e, sizeof(scheduled_contact_entry)));
+    m = NODE_NEXT(m);
+  }
+
+  /* The encoding is cached until the plan changes */
+  uint len2 = 0;
+  bt_assert(get_sces_cbor(&len2) == data && len2 == len);
+
+  /* Only the entries added after a version are encoded */
+  linpool *lp = lp_new_default(&root_pool);
+  u32 version = st->version, upto = 0;
+  bt_assert(!get_sces_cbor_since(version, 0xffff, lp, &len, &upto));
+
+  scheduled_contact_entry *f = sce_test_entries(3, 100);
+  for (uint i = 0; i < 3; i++)
+    bt_assert(sce_store_add(st, &f[i]));
+
+  data = get_sces_cbor_since(version, 0xffff, lp, &len, &upto);
+  bt_assert(data && data[0] == 0x83 && upto == st->version);
+
+  bt_assert(sce_store_decode(&dst, data, len, NULL, NULL) == 3);
+  bt_assert(sce_set_count(&dst.set) == 103);
+  for (uint i = 0; i < 3; i++)
+    bt_assert(sce_set_find(&dst.set, &f[i]));
+
+  /* Decoding known entries does not add them twice */
+  data = get_sces_cbor(&len);
+  bt_assert(sce_store_decode(&dst, data, len, NULL, NULL) == 103);
+  bt_assert(sce_set_count(&dst.set) == 103);
+
+  /* A plan, that does not fit, is encoded in parts in the order of the store */
+  struct sce_store part;
+  sce_test_store_init(&part);
+
+  uint parts = 0;
+  u32 sent = 0;
+  while ((data = get_sces_cbor_since(sent, 500, lp, &len, &upto)))
+  {
+    bt_assert((len <= 500) && (upto > sent));
+    bt_assert(sce_store_decode(&part, data, len, NULL, NULL) > 0);
+    sent = upto;
+    parts++;
+  }
+
+  bt_assert((parts > 1) && (sent == st->version));
+  bt_assert(sce_set_count(&part.set) == 103);
+
+  m = HEAD(part.set.list);
+  WALK_LIST(n, st->set.list)
+  {
+    bt_assert(!memcmp(&n->e, &m->e, sizeof(scheduled_contact_entry)));
+    m = NODE_NEXT(m);
+  }
+
+  /* Nothing fits */
+  bt_assert(!get_sces_cbor_since(0, 10, lp, &len, &upto));
+
+  xfree(e);
+  xfree(f);
+
+  sce_test_rmdir();
+  return 1;
+}
+
+static int
+t_encode_scheduled(void)
+{
+  resource_init();
+  timer_init();
+  proto_pool = &root_pool;
+  sce_test_chdir();
+
+  struct sce_store *st = sce_store_get();
+  scheduled_contact_entry *e = sce_test_entries(200, 0);
+  for (uint i = 0; i < 200; i++)
+    bt_assert(sce_store_add(st, &e[i]));
+
+  linpool *lp = lp_new_default(&root_pool);
+  ea_list none = {};
+  byte buf[1024];
+
+  /* The fake write state of the MRT table dump gets the whole plan, if it fits */
+  struct bgp_write_state mrt = { .as4_session = 1 };
+  bt_assert(bgp_encode_attrs(&mrt, &none, buf, buf + sizeof(buf)) == 0);
+
+  byte *big = xmalloc(65536);
+  int len = bgp_encode_attrs(&mrt, &none, big, big + 65536);
+  bt_assert((len > 1024) && (big[1] == BA_SCHEDULED));
+  xfree(big);
+
+  /* The peer gets the plan in parts, without failing the UPDATEs */
+  struct bgp_channel bc = {};
+  struct bgp_write_state s = { .channel = &bc, .pool = lp, .as4_session = 1 };
+  bt_assert(bgp_encode_attrs(&s, &none, buf, buf + 3) == 0);
+
+  struct sce_store dst;
+  sce_test_store_init(&dst);
+
+  uint updates = 0;
+  while ((len = bgp_encode_attrs(&s, &none, buf, buf + sizeof(buf))) > 0)
+  {
+    bt_assert((buf[1] == BA_SCHEDULED) && (4 + get_u16(buf + 2) == len));
+    bt_assert(sce_store_decode(&dst, buf + 4, len - 4, NULL, NULL) > 0);
+    updates++;
+  }
+
+  bt_assert((len == 0) && (updates > 1) && (bc.sce_sent == st->version));
+  bt_assert(sce_set_count(&dst.set) == 200);
+
+  rfree(lp);
+  xfree(e);
+
+  sce_test_rmdir();
+  return 1;
+}
+
+static int
+t_cbor_decode_invalid(void)
+{
+  resource_init();
+  timer_init();
+
+  struct sce_store st;
+  sce_test_store_init(&st);
+
+  /* A contact one day ahead */
+  u64 f = sce_test_now() + 86400000;
+
+  byte buf[1024], *d = buf;
+  uint size = sizeof(buf);
+
+  d = cbor_write_array(d, size, 3);
+  for (int i = 0; i < 3; i++)
+  {
+    d = cbor_write_array(d, size, 6);
+    d = cbor_write_long(d, size, f);
+    d = cbor_write_long(d, size, 20 + (i == 2 ? 0 : i));
+    d = cbor_write_int(d, size, 65000 + i);
+    d = cbor_write_int(d, size, 0x0a000001);
+    d = cbor_write_int(d, size, 7);
+    d = cbor_write_int(d, size, 0xc0a80101);
+  }
+
+  uint len = d - buf;
+  bt_assert(sce_store_decode(&st, buf, len, NULL, NULL) == 3);
+  bt_assert(sce_set_count(&st.set) == 3);
+
+  struct sce_node *n = HEAD(st.set.list);
+  bt_assert(n->e.start_time == f && n->e.asn1 == 65000 && n->e.gw2 == 0xc0a80101);
+
+  /* Truncated data */
+  for (uint l = 0; l < len; l++)
+    bt_assert(sce_store_decode(&st, buf, l, NULL, NULL) == -1);
+
+  /* Array longer than the data */
+  byte big[] = { 0x9a, 0xff, 0xff, 0xff, 0xff, 0x86, 1, 1, 1, 1, 1, 1 };
+  bt_assert(sce_store_decode(&st, big, sizeof(big), NULL, NULL) == -1);
+
+  /* Negative integer */
+  byte neg[] = { 0x81, 0x86, 1, 1, 0x20, 1, 1, 1 };
+  bt_assert(sce_store_decode(&st, neg, sizeof(neg), NULL, NULL) == -1);
+
+  /* ASN above 32 bits */
+  byte wide_tail[] = { 1, 0x1b, 0, 0, 0, 1, 0, 0, 0, 0, 1, 2, 3 };
+  d = cbor_write_array(buf, size, 1);
+  d = cbor_write_array(d, size, 6);
+  d = cbor_write_long(d, size, f);
+  memcpy(d, wide_tail, sizeof(wide_tail));
+  bt_assert(sce_store_decode(&st, buf, d - buf + sizeof(wide_tail), NULL, NULL) == -1);
+
+  byte ok_tail[] = { 1, 0x1a, 0xff, 0xff, 0xff, 0xff, 1, 2, 3 };
+  d = cbor_write_array(buf, size, 1);
+  d = cbor_write_array(d, size, 6);
+  d = cbor_write_long(d, size, f);
+  memcpy(d, ok_tail, sizeof(ok_tail));
+  bt_assert(sce_store_decode(&st, buf, d - buf + sizeof(ok_tail), NULL, NULL) == 1);
+  bt_assert(sce_set_count(&st.set) == 4);
+
+  /* Expired entries are skipped */
+  byte old[] = { 0x81, 0x86, 1, 1, 1, 1, 2, 3 };
+  bt_assert(sce_store_decode(&st, old, sizeof(old), NULL, NULL) == 1);
+  bt_assert(sce_set_count(&st.set) == 4);
+
+  bt_assert(sce_store_expire(&st, f + 100) == 0);
+  bt_assert(sce_store_expire(&st, f + 86400000) == 4);
+  bt_assert(sce_set_count(&st.set) == 0);
+
+  return 1;
+}
+
+static void
+sce_test_write(const char *name, const char *data, size_t len)
+{
+  FILE *f = fopen(name, "w");
+  bt_assert(f && (fwrite(data, 1, len, f) == len));
+  fclose(f);
+}
+
+static int
+t_load_file(void)
+{
+  bt_bird_init();
+  sce_test_chdir();
+
+  struct sce_store st;
+  sce_test_store_init(&st);
+
+  char buf[1024];
+  u64 f = sce_test_now() + 86400000;
+  int len = snprintf(buf, sizeof(buf),
+      "# start,duration,asn1,gw1,asn2,gw2\n"
+      "%lu,60000,65001,10.0.0.1,65002,10.0.0.2\n"
+      "\n"
+      "  %lu , 60000 , 65002 , 10.0.0.2 , 65001 , 10.0.0.1  # the same contact\r\n"
+      "%lu,1000,65001,10.0.0.1,65003,10.0.0.3",
+      f, f, f + 5000);
+
+  sce_test_write("plan.csv", buf, len);
+  bt_assert(sce_store_load_file(&st, "plan.csv", 0, NULL, NULL) == 2);
+  bt_assert(sce_set_count(&st.set) == 2);
+
+  scheduled_contact_entry e = sce(f + 5000, 1000, 65003, 0x0a000003, 65001, 0x0a000001);
+  bt_assert(sce_set_find(&st.set, &e));
+
+  /* An unchanged file is skipped, a forced load adds nothing new */
+  bt_assert(sce_store_load_file(&st, "plan.csv", 0, NULL, NULL) == 0);
+  bt_assert(sce_store_load_file(&st, "plan.csv", 1, NULL, NULL) == 0);
+  bt_assert(st.plan_file && !strcmp(st.plan_file, "plan.csv"));
+
+  /* A malformed file does not change the plan */
+  const char *bad[] = {
+    "1,2,3,10.0.0.1,4\n",
+    "1,2,3,10.0.0.1,4,10.0.0.256\n",
+    "1,2,4294967296,10.0.0.1,4,10.0.0.2\n",
+    "1,2,3,10.0.0.1,4,10.0.0.2,5\n",
+    "18446744073709551616,2,3,10.0.0.1,4,10.0.0.2\n",
+    "1,2,3,10.0.1,4,10.0.0.2\n",
+    "1;2;3;10.0.0.1;4;10.0.0.2\n",
+  };
+
+  for (uint i = 0; i < ARRAY_SIZE(bad); i++)
+  {
+    len = snprintf(buf, sizeof(buf), "%lu,10,1,1.1.1.1,2,2.2.2.2\n%s", f, bad[i]);
+    sce_test_write("bad.csv", buf, len);
+    bt_assert_msg(sce_store_load_file(&st, "bad.csv", 0, NULL, NULL) == -1, "Line %s must be rejected", bad[i]);
+  }
+
+  bt_assert(sce_set_count(&st.set) == 2);
+  bt_assert(sce_store_load_file(&st, "missing.csv", 0, NULL, NULL) == -1);
+
+  /* CBOR plans are recognized by their first byte. The global store loads
+     the journal, so it knows the contacts of plan.csv as well. */
+  struct sce_store *gst = sce_store_get();
+  scheduled_contact_entry *g = sce_test_entries(10, 0);
+  for (uint i = 0; i < 10; i++)
+    sce_store_add(gst, &g[i]);
+
+  uint size;
+  byte *data = get_sces_cbor(&size);
+  sce_test_write("plan.cbor", (char *) data, size);
+  bt_assert(sce_store_load_file(&st, "plan.cbor", 0, NULL, NULL) == 10);
+  bt_assert(sce_set_count(&st.set) == 12);
+
+  /* Empty plan */
+  sce_test_write("empty.csv", "", 0);
+  bt_assert(sce_store_load_file(&st, "empty.csv", 0, NULL, NULL) == 0);
+
+  xfree(g);
+
+  sce_test_rmdir();
+  return 1;
+}
+
+static int
+t_journal(void)
+{
+  resource_init();
+  timer_init();
+  proto_pool = &root_pool;
+  sce_test_chdir();
+
+  struct sce_store *st = sce_store_get();
+  struct stat si;
+  bt_assert(!stat(SCES_FILENAME, &si) && si.st_size == 16);
+
+  u64 f = sce_test_now() + 86400000;
+  scheduled_contact_entry a[] = {
+    sce(f, 5, 1, 11, 2, 22),
+    sce(f, 5, 2, 22, 1, 11),
+    sce(f + 1, 5, 1, 11, 2, 22),
+  };
+  scheduled_contact_entries x = { ARRAY_SIZE(a), a };
+
+  /* Each new entry is appended as one record */
+  store_sces(&x, NULL, NULL);
+  bt_assert(!stat(SCES_FILENAME, &si) && si.st_size == 16 + 2 * 40);
+  bt_assert(st->journal_records == 2);
+
+  sce_store_save(st);
+  bt_assert(!stat(SCES_FILENAME, &si) && si.st_size == 16 + 2 * 40);
+
+  sce_test_rmdir();
+  return 1;
+}
+
+static int
+t_journal_header(void)
+{
+  bt_bird_init();
+  sce_test_chdir();
+
+  /* A journal of a newer version, its size also fits the old format */
+  byte buf[16 + 2 * 40] = {};
+  put_u32(buf, SCE_JOURNAL_MAGIC);
+  put_u16(buf + 4, SCE_JOURNAL_VERSION + 1);
+  put_u16(buf + 6, SCE_JOURNAL_REC_SIZE);
+  memset(buf + 16, 0xff, sizeof(buf) - 16);
+
+  int fd = open(SCES_FILENAME, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  bt_assert((fd >= 0) && (write(fd, buf, sizeof(buf)) == sizeof(buf)));
+  close(fd);
+
+  /* It is moved aside and the plan starts empty */
+  struct sce_store *st = sce_store_get();
+  struct stat si;
+  bt_assert(!sce_set_count(&st->set) && !st->journal_records);
+  bt_assert(!stat(SCES_FILENAME ".bad", &si) && si.st_size == sizeof(buf));
+  bt_assert(!stat(SCES_FILENAME, &si) && si.st_size == 16);
+
+  sce_test_rmdir();
+  return 1;
+}
+
+static int
+t_sched(void)
+{
+  resource_init();
+  timer_init();
+
+  pool *p = rp_new(&root_pool, "Test pool");
+  struct sce_set set;
+  struct sce_sched sc;
+  sce_set_init(&set, p);
+  sce_sched_init(&sc, p);
+
+  struct sce_node *nodes[100];
+  for (int i = 0; i < 100; i++)
+  {
+    scheduled_contact_entry e = sce(1000000000000ULL + (u64) ((i * 37) % 100) * 1000, 500 + i, 1, 2, 3 + i, 4);
+    nodes[i] = sce_set_add(&set, &e);
+  }
+
+  /* Each contact gets its begin, end and prepare events */
+  sce_sched_add_sces(&sc, nodes, 50, NULL, NULL);
+  sce_sched_add_sces(&sc, nodes + 50, 10, NULL, NULL);
+  for (int i = 60; i < 100; i++)
+    sce_sched_add_sces(&sc, nodes + i, 1, NULL, NULL);
+
+  bt_assert(sc.heap.used == 301);
+
+  for (int i = 0; i < 100; i += 3)
+    sce_sched_cancel(&sc, nodes[i]);
+
+  bt_assert(sc.heap.used == 301 - 3 * 34);
+
+  struct sce_event *ev;
+  u64 last = 0;
+  while ((ev = sce_sched_first(&sc)))
+  {
+    bt_assert(ev->when >= last);
+    last = ev->when;
+
+    struct sce_node *n = ev->node;
+    sce_sched_cancel(&sc, n);
+    bt_assert(!n->events[0] && !n->events[1] && !n->events[2]);
+  }
+
+  return 1;
+}
+
+static int
+t_sched_fire(void)
+{
+  bt_bird_init();
+
+  pool *p = rp_new(&root_pool, "Test pool");
+  struct sce_set set;
+  struct sce_sched sc;
+  sce_set_init(&set, p);
+  sce_sched_init(&sc, p);
+
+  struct sce_node *nodes[60];
+  for (int i = 0; i < 60; i++)
+  {
+    scheduled_contact_entry e = sce(sce_test_now() - 1 - (i % 3), 600000, 1, 2, 3 + i, 4);
+    nodes[i] = sce_set_add(&set, &e);
+  }
+
+  scheduled_contact_entry e = sce(1ULL << 60, 10, 1, 2, 3, 5);
+  struct sce_node *future = sce_set_add(&set, &e);
+
+  e = sce(sce_test_now() + 5000, 10, 1, 2, 3, 7);
+  struct sce_node *soon = sce_set_add(&set, &e);
+
+  sce_sched_add_sces(&sc, nodes, 60, NULL, NULL);
+  sce_sched_add_sces(&sc, &future, 1, NULL, NULL);
+  sce_sched_add_sces(&sc, &soon, 1, NULL, NULL);
+
+  /* The running contacts begin, the one in the look-ahead window is prepared */
+  sc.timer->hook(sc.timer);
+  bt_assert(sc.fired == 60);
+  bt_assert(sc.heap.used == 66);
+  bt_assert(sc.pending.used == 1 && sc.pending.data[0] == soon && !soon->events[SCE_EV_PREPARE]);
+
+  sc.prepare->hook(sc.prepare->data);
+  bt_assert(sc.prepared == 1 && !sc.pending.used && !soon->stage);
+
+  /* Contacts which have already ended are not scheduled */
+  e = sce(1000, 10, 1, 2, 3, 6);
+  struct sce_node *old = sce_set_add(&set, &e);
+  sce_sched_add_sces(&sc, &old, 1, NULL, NULL);
+  bt_assert(sc.heap.used == 66 && !old->events[0]);
+
+  return 1;
+}
+
+static int
+t_sched_clock(void)
+{
+  bt_bird_init();
+
+  pool *p = rp_new(&root_pool, "Test pool");
+  struct sce_set set;
+  struct sce_sched sc;
+  sce_set_init(&set, p);
+  sce_sched_init(&sc, p);
+
+  /* The timer is anchored to the real time of the contact with ms precision */
+  scheduled_contact_entry e = sce(sce_test_now() + 60000, 10, 1, 2, 3, 4);
+  struct sce_node *n = sce_set_add(&set, &e);
+  sce_sched_add_sces(&sc, &n, 1, NULL, NULL);
+
+  btime real = (btime) (n->events[SCE_EV_PREPARE]->when + DTNEPOCH) MS_;
+  bt_assert(sc.timer->expires == real - (current_real_time() - current_time()));
+  bt_assert(tm_active(sc.clock));
+
+  /* Small drift is ignored */
+  btime expires = sc.timer->expires;
+  btime offset = sc.offset;
+  sc.offset += SCE_CLOCK_STEP / 2;
+  sc.clock->hook(sc.clock);
+  bt_assert(sc.offset == offset + SCE_CLOCK_STEP / 2 && !sc.steps);
+
+  /* The timer was set while the real-time clock was 10 s behind, it is re-anchored */
+  sc.offset = offset - 10 S_;
+  tm_set(sc.timer, expires + 10 S_);
+  sc.clock->hook(sc.clock);
+  bt_assert_msg(sc.timer->expires == expires, "expires %ld, expected %ld", (long) sc.timer->expires, (long) expires);
+  bt_assert(sc.offset == offset && sc.steps == 1);
+
+  /* Likewise, if it was 10 s ahead */
+  sc.offset = offset + 10 S_;
+  tm_set(sc.timer, expires - 10 S_);
+  sc.clock->hook(sc.clock);
+  bt_assert(sc.timer->expires == expires && sc.steps == 2);
+
+  /* Nothing is watched without queued events */
+  sce_sched_cancel(&sc, n);
+  bt_assert(!tm_active(sc.timer) && !tm_active(sc.clock));
+
+  return 1;
+}
+
+static int
+t_contact_graph(void)
+{
+  resource_init();
+  timer_init();
+
+  struct sce_store st;
+  sce_test_store_init(&st);
+
+  u64 now = sce_test_now();
+  scheduled_contact_entry a[] = {
+    sce(now - 10, 100, 1, 1, 2, 2),
+    sce(now - 5, 100, 3, 3, 2, 2),
+    sce(now + 50, 100, 3, 3, 4, 4),
+    sce(now - 100, 50, 1, 1, 4, 4),
+    sce(now + 20, 10, 1, 1, 4, 4),
+  };
+
+  for (uint i = 0; i < ARRAY_SIZE(a); i++)
+    sce_store_add(&st, &a[i]);
+
+  struct sce_cg *cg = sce_cg_get(&st, 1, now);
+
+  struct sce_cg_route *r = sce_cg_route_get(cg, 3);
+  bt_assert(r && r->len == 3 && r->asns[0] == 1 && r->asns[1] == 2 && r->asns[2] == 3);
+  bt_assert(r && r->arrival == now && sce_cg_route_open(r, now));
+
+  /* The direct contact to AS 4 begins before the chain over AS 3 */
+  r = sce_cg_route_get(cg, 4);
+  bt_assert(r && r->len == 2 && r->arrival == now + 20);
+  bt_assert(r && !sce_cg_route_open(r, now));
+  bt_assert(sce_cg_route_get(cg, 4) == r);
+
+  bt_assert(!sce_cg_route_get(cg, 9));
+
+  return 1;
+}
+
+static int
+t_contact_windows(void)
+{
+  resource_init();
+  timer_init();
+
+  struct sce_store st;
+  sce_test_store_init(&st);
+
+  struct sce_node **nodes;
+  bt_assert(sce_store_overlaps(&st, 0, ~0ULL, &nodes) == 0);
+  mb_free(nodes);
+
+  /* Random windows of the next hour, compared with a linear scan of the plan */
+  u64 now = sce_test_now();
+  for (uint i = 0; i < 1000; i++)
+  {
+    scheduled_contact_entry e = sce(now + bt_random() % 3600000, 1 + bt_random() % 600000,
+				    65000 + i % 50, 0x0a000001, 64512, 0x0a000002);
+    sce_store_add(&st, &e);
+  }
+
+  for (uint round = 0; round < 2; round++)
+  {
+    for (uint q = 0; q < 200; q++)
+    {
+      u64 start = now + bt_random() % 4000000;
+      u64 end = start + ((q % 2) ? 1 : bt_random() % 100000 + 1);
+
+      uint num = sce_store_overlaps(&st, start, end, &nodes);
+      uint expected = 0, found = 0;
+
+      struct sce_node *n;
+      WALK_LIST(n, st.set.list)
+	if ((n->e.start_time < end) && (start < n->e.start_time + n->e.duration))
+	  expected++;
+
+      for (uint i = 0; i < num; i++)
+	if ((nodes[i]->e.start_time < end) && (start < nodes[i]->e.start_time + nodes[i]->e.duration))
+	  found++;
+
+      bt_assert_msg((num == expected) && (found == num), "%u of %u contacts found", num, expected);
+      mb_free(nodes);
+    }
+
+    /* The index follows the removal of contacts */
+    for (uint i = 0; i < 300; i++)
+      sce_store_remove(&st, HEAD(st.set.list));
+  }
+
+  /* Windows of the same pair, the second one is shorter and from the other side */
+  scheduled_contact_entry a = sce(now + 10000000, 1000, 1, 1, 2, 2);
+  scheduled_contact_entry b = sce(now + 10000500, 200, 2, 3, 1, 4);
+  scheduled_contact_entry c = sce(now + 10000600, 1000, 1, 1, 3, 3);
+  sce_store_add(&st, &a);
+  struct sce_node *nb = sce_store_add(&st, &b);
+  sce_store_add(&st, &c);
+
+  bt_assert(sce_store_pair_open(&st, &b, now + 10000700) == sce_set_find(&st.set, &a));
+  bt_assert(sce_store_pair_open(&st, &a, now + 10000600) == nb);
+  bt_assert(!sce_store_pair_open(&st, &a, now + 10000700));
+  bt_assert(!sce_store_pair_open(&st, &a, now + 10001000));
+  bt_assert(!sce_store_pair_open(&st, &c, now + 10000700));
+
+  return 1;
+}
+
+static int
+t_restart(void)
+{
+  bt_bird_init();
+
+  struct sce_store st;
+  sce_test_store_init(&st);
+
+  /* An ended, an open and a future contact, as loaded from the journal */
+  u64 now = sce_test_now();
+  scheduled_contact_entry a[] = {
+    sce(now - 20000, 10000, 1, 1, 2, 2),
+    sce(now - 10000, 600000, 1, 1, 3, 3),
+    sce(now + 600000, 10000, 1, 1, 4, 4),
+  };
+
+  struct sce_node *n[3];
+  for (uint i = 0; i < ARRAY_SIZE(a); i++)
+    n[i] = sce_store_add(&st, &a[i]);
+
+  /* Only the end of the open contact is queued, the future one gets all its events */
+  sce_store_restart(&st, NULL, NULL);
+  bt_assert(!n[0]->events[SCE_EV_BEGIN] && !n[0]->events[SCE_EV_END]);
+  bt_assert(!n[1]->events[SCE_EV_BEGIN] && n[1]->events[SCE_EV_END] && !n[1]->events[SCE_EV_PREPARE]);
+  bt_assert(n[2]->events[SCE_EV_BEGIN] && n[2]->events[SCE_EV_END] && n[2]->events[SCE_EV_PREPARE]);
+  bt_assert(st.sched.heap.used == 5);
+
+  /* The plan is handed over only once */
+  sce_store_restart(&st, NULL, NULL);
+  bt_assert(st.sched.heap.used == 5);
+
+  /* The routes of the peer are known, the open contact begins again */
+  sce_store_reopen(&st, NULL);
+  bt_assert(n[1]->events[SCE_EV_BEGIN] && (sce_sched_first(&st.sched) == n[1]->events[SCE_EV_BEGIN]));
+  bt_assert(st.sched.heap.used == 6);
+
+  sce_store_reopen(&st, NULL);
+  bt_assert(st.sched.heap.used == 6);
+
+  /* A contact beginning before the channel is up computes no routes */
+  struct rtable_config tc = { .name = "test", .addr_type = NET_IP4 };
+  struct channel c = { .table = rt_setup(&root_pool, &tc), .channel_state = CS_START };
+  struct bgp_proto bp = { .public_as = 1 };
+  entry_data ed = { .sce = &n[1]->e, .ch = &c, .proto = &bp };
+  entry_data *eds[] = { &ed };
+
+  modify_routingtable_add(eds, 1);
+  bt_assert(!c.table->sce_index);
+
+  return 1;
+}
+
+static int
+t_unbind(void)
+{
+  bt_bird_init();
+
+  struct sce_store st;
+  sce_test_store_init(&st);
+
+  struct bgp_proto bp = { .p = { .name = "old", .proto = &proto_bgp } };
+  struct channel c = { .name = "ipv4", .proto = &bp.p };
+
+  /* An open and a future contact of the protocol, that is going to be removed */
+  u64 now = sce_test_now();
+  scheduled_contact_entry a[] = {
+    sce(now - 10000, 600000, 1, 1, 2, 2),
+    sce(now + 600000, 10000, 1, 1, 3, 3),
+  };
+
+  struct sce_node *n[2];
+  for (uint i = 0; i < ARRAY_SIZE(a); i++)
+    n[i] = sce_store_add(&st, &a[i]);
+
+  sce_store_restart(&st, &c, &bp);
+  bt_assert(!n[0]->events[SCE_EV_BEGIN] && n[0]->events[SCE_EV_END]);
+
+  /* Another BGP protocol takes the contacts over, the open one begins there again */
+  struct bgp_proto bp2 = { .p = { .name = "new", .proto = &proto_bgp } };
+  struct channel c2 = { .name = "ipv4", .proto = &bp2.p };
+  init_list(&bp2.p.channels);
+  add_tail(&bp2.p.channels, &c2.n);
+  add_tail(&proto_list, &bp2.p.n);
+
+  sce_store_unbind(&st, &c);
+  for (uint i = 0; i < 2; i++)
+    for (u8 type = SCE_EV_BEGIN; type < SCE_EV_MAX; type++)
+      bt_assert(!n[i]->events[type] || ((n[i]->events[type]->ed.ch == &c2) && (n[i]->events[type]->ed.proto == &bp2)));
+
+  bt_assert(n[0]->events[SCE_EV_BEGIN] && n[0]->events[SCE_EV_END]);
+  bt_assert(n[1]->events[SCE_EV_BEGIN] && n[1]->events[SCE_EV_END]);
+
+  /* Without another BGP protocol, the contacts are cancelled */
+  rem_node(&bp2.p.n);
+  sce_store_unbind(&st, &c2);
+  bt_assert(!n[0]->events[SCE_EV_END] && !n[1]->events[SCE_EV_BEGIN]);
+  bt_assert(st.sched.heap.used == 1);
+
+  /* And the next protocol takes the plan over */
+  sce_store_restart(&st, &c, &bp);
+  bt_assert(n[0]->events[SCE_EV_END] && !n[0]->events[SCE_EV_BEGIN]);
+  bt_assert(n[1]->events[SCE_EV_BEGIN] && (n[1]->events[SCE_EV_BEGIN]->ed.ch == &c));
+
+  return 1;
+}
+
+static int
+t_contact_attr(void)
+{
+  bt_bird_init();
+
+  linpool *lp = lp_new_default(&root_pool);
+  struct bgp_proto bp = { .public_as = 100 };
+
+  u32 p1[] = { 2, 9 };
+  u32 p2[] = { 2, 3, 9 };
+  rte *tmpl = sce_test_route(lp, NULL, p1, ARRAY_SIZE(p1));
+  rte *path = sce_test_route(lp, NULL, p2, ARRAY_SIZE(p2));
+  struct rte_src src = {};
+  tmpl->attrs->src = &src;
+  eattr *a = ea_find(path->attrs->eattrs, EA_CODE(PROTOCOL_BGP, BA_AS_PATH));
+
+  /* The contact is recorded with the lower ASN first */
+  u64 now = sce_test_now();
+  scheduled_contact_entry e = sce(now - 1000, 61000, 3, 0x0a000003, 2, 0x0a000002);
+  rte *r = copy_rte_and_insert_as_path(&tmpl, a, &bp, &e);
+
+  u64 end;
+  u32 asn_lo, asn_hi;
+  eattr *c = ea_find(r->attrs->eattrs, EA_GEN_SCE);
+  bt_assert(sce_ea_get(c, &end, &asn_lo, &asn_hi));
+  bt_assert((end == now + 60000) && (asn_lo == 2) && (asn_hi == 3));
+  bt_assert((sce_ea_remaining(c) > 50000) && (sce_ea_remaining(c) <= 60000));
+  bt_assert(sce_test_path_is(ea_find(r->attrs->eattrs, EA_CODE(PROTOCOL_BGP, BA_AS_PATH)), p2, ARRAY_SIZE(p2)));
+
+  /* Routes without a contact and contacts that are over */
+  bt_assert(!sce_ea_get(NULL, &end, &asn_lo, &asn_hi) && !sce_ea_remaining(NULL));
+
+  e = sce(now - 2000, 1000, 3, 0x0a000003, 2, 0x0a000002);
+  rte *old = copy_rte_and_insert_as_path(&tmpl, a, &bp, &e);
+  bt_assert(!sce_ea_remaining(ea_find(old->attrs->eattrs, EA_GEN_SCE)));
+
+  rte_free(r);
+  rte_free(old);
+  sce_scratch_flush();
+  rfree(lp);
+
+  return 1;
+}
+
+static int
+t_refresh_local(void)
+{
+  bt_bird_init();
+
+  linpool *lp = lp_new_default(&root_pool);
+  struct rtable_config tc = { .name = "test", .addr_type = NET_IP4 };
+  rtable *t = rt_setup(&root_pool, &tc);
+  struct channel c = {};
+
+  net_addr_ip4 a = NET_ADDR_IP4(ip4_build(10, 0, 0, 0), 8);
+  net *n = net_get(t, (net_addr *) &a);
+
+  /* A route of the peer and a route derived from it over a contact */
+  u32 p1[] = { 2, 9 };
+  u32 p2[] = { 2, 3, 9 };
+  rte *local = sce_test_route(lp, NULL, p2, ARRAY_SIZE(p2));
+  rte *peer = sce_test_route(lp, local, p1, ARRAY_SIZE(p1));
+  local->flags = REF_LOCAL;
+  peer->sender = local->sender = &c;
+  peer->net = local->net = n;
+  n->routes = peer;
+
+  /* The peer does not send the derived route again, it must not be pruned */
+  rt_refresh_begin(t, &c);
+  bt_assert((peer->flags & REF_STALE) && !(local->flags & REF_STALE));
+
+  rt_refresh_end(t, &c);
+  bt_assert((peer->flags & REF_DISCARD) && !(local->flags & REF_DISCARD));
+
+  rt_modify_stale(t, &c);
+  bt_assert((peer->flags & REF_MODIFY) && !(local->flags & REF_MODIFY));
+
+  n->routes = NULL;
+  rfree(lp);
+
+  return 1;
+}
+
+static int
+t_mrt_contacts(void)
+{
+  bt_bird_init();
+  sce_test_chdir();
+
+  int fd = open("contacts.mrt", O_RDWR | O_CREAT | O_TRUNC, 0644);
+  bt_assert(fd >= 0);
+
+  struct config cf = { .mrtdump_file = fd };
+  struct config *old = config;
+  config = &cf;
+
+  struct bgp_proto bp = { .public_as = 100, .remote_as = 2 };
+  scheduled_contact_entry e[2] = {
+    sce(1000, 50, 100, 0x0a000001, 2, 0x0a000002),
+    sce(1010, 60, 2, 0x0a000002, 3, 0x0a000003),
+  };
+  entry_data ed[2] = { { .sce = &e[0], .proto = &bp }, { .sce = &e[1], .proto = &bp } };
+  entry_data *eds[2] = { &ed[0], &ed[1] };
+
+  /* Nothing is recorded unless enabled, without a channel no routes are computed */
+  contact_begin(eds, 2);
+  bt_assert(lseek(fd, 0, SEEK_CUR) == 0);
+
+  bp.p.mrtdump = MD_CONTACTS;
+  contact_begin(eds, 2);
+  contact_end(eds, 1);
+  sce_scratch_flush();
+  config = old;
+
+  byte buf[256];
+  ssize_t len = pread(fd, buf, sizeof(buf), 0);
+  close(fd);
+
+#ifdef CONFIG_MRT
+  /* One record per batch, the contacts in the order of the batch */
+  uint begin_len = MRT_SCE_HDR_LENGTH + 4 + 2 * MRT_SCE_CONTACT_LENGTH;
+  uint end_len = MRT_SCE_HDR_LENGTH + 4 + MRT_SCE_CONTACT_LENGTH;
+  bt_assert(len == 2 * MRT_HDR_LENGTH + begin_len + end_len);
+
+  const byte *d = buf;
+  bt_assert(get_u16(d + 4) == MRT_SCE && get_u16(d + 6) == MRT_SCE_CONTACT_BEGIN && get_u32(d + 8) == begin_len);
+
+  d += MRT_HDR_LENGTH;
+  bt_assert(get_u32(d) == 100 && get_u32(d + 4) == 2 && get_u32(d + 8) == 2);
+
+  d += MRT_SCE_HDR_LENGTH + 4 + MRT_SCE_CONTACT_LENGTH;
+  bt_assert(get_u64(d) == 1010 && get_u64(d + 8) == 60);
+  bt_assert(get_u32(d + 16) == 2 && get_u32(d + 20) == 0x0a000002);
+  bt_assert(get_u32(d + 24) == 3 && get_u32(d + 28) == 0x0a000003);
+
+  d = buf + MRT_HDR_LENGTH + begin_len;
+  bt_assert(get_u16(d + 6) == MRT_SCE_CONTACT_END && get_u32(d + 8) == end_len);
+  bt_assert(get_u64(d + MRT_HDR_LENGTH + MRT_SCE_HDR_LENGTH + 4) == 1000);
+#else
+  bt_assert(len == 0);
+#endif
+
+  sce_test_rmdir();
+  return 1;
+}
+
+
+/*
+ *	Benchmarks
+ */
+
+static int
+t_bench_diff(const void *arg)
+{
+  uint num = (uintptr_t) arg;
+
+  resource_init();
+  timer_init();
+
+  /* The second half of the existing entries is sent again */
+  scheduled_contact_entry *a = sce_test_entries(num, 0);
+  scheduled_contact_entry *b = sce_test_entries(num, num / 2);
+  scheduled_contact_entries x = { num, a }, y = { num, b };
+
+  btime t0 = sce_test_clock();
+  scheduled_contact_entries *n = find_new_sces(&y, &x);
+  btime t1 = sce_test_clock();
+  scheduled_contact_entries *m = merge_sces(&x, &y);
+  btime t2 = sce_test_clock();
+
+  bt_assert(n->number_of_entries == num / 2);
+  bt_assert(m->number_of_entries == num + num / 2);
+
+  bt_debug("find_new_sces: %u entries in %ld us\n", num, (long) (t1 - t0));
+  bt_debug("merge_sces: %u entries in %ld us\n", num, (long) (t2 - t1));
+
+  bt_assert_msg(t1 - t0 < SCE_BENCH_LIMIT(num), "find_new_sces took %ld us for %u entries", (long) (t1 - t0), num);
+  bt_assert_msg(t2 - t1 < SCE_BENCH_LIMIT(num), "merge_sces took %ld us for %u entries", (long) (t2 - t1), num);
+
+  free(n->entries);
+  free(n);
+  free(m->entries);
+  free(m);
+  xfree(a);
+  xfree(b);
+
+  return 1;
+}
+
+static int
+t_bench_cbor(const void *arg)
+{
+  uint num = (uintptr_t) arg;
+
+  resource_init();
+  timer_init();
+  proto_pool = &root_pool;
+  sce_test_chdir();
+
+  struct sce_store *st = sce_store_get();
+  scheduled_contact_entry *e = sce_test_entries(num, 0);
+
+  btime t0 = sce_test_clock();
+  for (uint i = 0; i < num; i++)
+    sce_store_add(st, &e[i]);
+
+  btime t1 = sce_test_clock();
+  uint len = 0;
+  byte *data = get_sces_cbor(&len);
+
+  btime t2 = sce_test_clock();
+  struct sce_store dst;
+  sce_test_store_init(&dst);
+  int decoded = sce_store_decode(&dst, data, len, NULL, NULL);
+
+  btime t3 = sce_test_clock();
+
+  bt_assert(sce_set_count(&st->set) == num);
+  bt_assert(decoded == (int) num);
+  bt_assert(sce_set_count(&dst.set) == num);
+
+  bt_debug("sce_store_add: %u entries in %ld us\n", num, (long) (t1 - t0));
+  bt_debug("encode: %u entries (%u bytes) in %ld us\n", num, len, (long) (t2 - t1));
+  bt_debug("decode: %u entries in %ld us\n", num, (long) (t3 - t2));
+
+  bt_assert_msg(t1 - t0 < SCE_BENCH_LIMIT(num), "sce_store_add took %ld us for %u entries", (long) (t1 - t0), num);
+  bt_assert_msg(t2 - t1 < SCE_BENCH_LIMIT(num), "Encoding took %ld us for %u entries", (long) (t2 - t1), num);
+  bt_assert_msg(t3 - t2 < SCE_BENCH_LIMIT(num), "Decoding took %ld us for %u entries", (long) (t3 - t2), num);
+
+  xfree(e);
+  sce_test_rmdir();
+
+  return 1;
+}
+
+
+static int
+t_bench_load(const void *arg)
+{
+  uint num = (uintptr_t) arg;
+
+  bt_bird_init();
+  sce_test_chdir();
+
+  scheduled_contact_entry *e = sce_test_entries(num, 0);
+  FILE *f = fopen("plan.csv", "w");
+  bt_assert(f);
+
+  for (uint i = 0; i < num; i++)
+    fprintf(f, "%lu,%lu,%u,10.0.0.1,%u,10.0.0.2\n",
+	    (unsigned long) e[i].start_time, (unsigned long) e[i].duration, e[i].asn1, e[i].asn2);
+
+  fclose(f);
+
+  struct sce_store st;
+  sce_test_store_init(&st);
+
+  btime t0 = sce_test_clock();
+  int added = sce_store_load_file(&st, "plan.csv", 0, NULL, NULL);
+  btime t1 = sce_test_clock();
+
+  bt_assert(added == (int) num);
+  bt_assert(sce_set_count(&st.set) == num);
+
+  bt_debug("sce_store_load_file: %u entries in %ld us\n", num, (long) (t1 - t0));
+  bt_assert_msg(t1 - t0 < SCE_BENCH_LIMIT(num), "Loading took %ld us for %u entries", (long) (t1 - t0), num);
+
+  xfree(e);
+  sce_test_rmdir();
+
+  return 1;
+}
+
+int
+main(int argc, char *argv[])
+{
+  bt_init(argc, argv);
+
+  bt_test_suite(t_check_equal_sces, "Equality of scheduled contact entries");
+  bt_test_suite(t_find_new_sces, "Filtering of already known entries");
+  bt_test_suite(t_merge_sces, "Merging of two sets of entries");
+  bt_test_suite(t_path_contains_as_pair, "Searching an AS pair in an AS_PATH");
+  bt_test_suite(t_insert_sce_in_path, "Building new AS_PATHs over a contact");
+  bt_test_suite(t_remove_duplicates, "Removal of duplicate candidate paths");
+  bt_test_suite(t_scratch_threads, "Path computations in several threads");
+  bt_test_suite(t_worker, "Stages computed by the worker thread");
+  bt_test_suite(t_cbor_roundtrip, "CBOR encoding and decoding of the plan");
+  bt_test_suite(t_cbor_decode_invalid, "Decoding of invalid CBOR data");
+  bt_test_suite(t_encode_scheduled, "Contact plan in UPDATEs and MRT dumps");
+  bt_test_suite(t_load_file, "Loading of CSV and CBOR plan files");
+  bt_test_suite(t_journal, "Journal of the plan");
+  bt_test_suite(t_journal_header, "Journal with an invalid header");
+  bt_test_suite(t_sched, "Ordering and cancelling of contact events");
+  bt_test_suite(t_sched_fire, "Firing of due contact events");
+  bt_test_suite(t_sched_clock, "Re-anchoring of contact events on clock steps");
+  bt_test_suite(t_contact_graph, "Earliest arrival routes over the contact graph");
+  bt_test_suite(t_contact_windows, "Interval index of the contact windows");
+  bt_test_suite(t_restart, "Scheduling of the persisted plan after a restart");
+  bt_test_suite(t_unbind, "Contacts of a removed protocol");
+  bt_test_suite(t_contact_attr, "Contact attribute of the routes over a contact");
+  bt_test_suite(t_refresh_local, "Derived routes kept over a route refresh");
+  bt_test_suite(t_mrt_contacts, "MRT records of contacts");
+
+  for (uint num = 10; num <= 100000; num *= 100)
+  {
+    bt_test_suite_arg_extra(t_bench_diff, (void *) (uintptr_t) num, BT_FORKING, SCE_BENCH_TIMEOUT,
+			    "Benchmark of find_new_sces and merge_sces with %u entries", num);
+    bt_test_suite_arg_extra(t_bench_cbor, (void *) (uintptr_t) num, BT_FORKING, SCE_BENCH_TIMEOUT,
+			    "Benchmark of the plan and its CBOR encoding with %u entries", num);
+    bt_test_suite_arg_extra(t_bench_load, (void *) (uintptr_t) num, BT_FORKING, SCE_BENCH_TIMEOUT,
+			    "Benchmark of loading a CSV plan file with %u entries", num);
+  }
+
+  return bt_exit_value();
+}
@@ -13,12 +13,18 @@
  * The MRT protocol is implemented in just one file: |mrt.c|. It contains of
  * several parts: Generic functions for preparing MRT messages in a buffer,
  * functions for MRT table dump (called from timer or CLI), functions for MRT
- * BGP4MP dump (called from BGP), and the usual protocol glue. For the MRT table
+ * BGP4MP dump (called from BGP), functions for the dump of scheduled contacts
+ * (called from the SCE extension of BGP), and the usual protocol glue. For the MRT table
  * dump, the key structure is struct mrt_table_dump_state, which contains all
  * necessary data and created when the MRT dump cycle is started for the
  * duration of the MRT dump. The MBGP4MP dump is currently not bound to MRT
  * protocol instance and uses the config->mrtdump_file fd.
  *
+ * The dump of scheduled contacts uses the private MRT type %MRT_SCE and the
+ * same fd. Every batch of contacts that began or ended is written as one record,
+ * followed by one record for each route added or withdrawn by the batch. The
+ * perf protocol can replay such a dump on an MRT table dump.
+ *
  * The protocol is simple, just periodically scans routing table and export it
  * to a file. It does not use the regular update mechanism, but a direct access
  * in order to handle iteration through multiple routing tables. The table dump
@@ -830,6 +836,79 @@ mrt_dump_bgp_state_change(struct mrt_bgp_data *d)
 }
 
 
+/*
+ *	MRT SCE dump
+ */
+
+static void
+mrt_sce_header(buffer *b, struct mrt_sce_data *d)
+{
+  mrt_put_u32(b, d->local_as);
+  mrt_put_u32(b, d->peer_as);
+}
+
+void
+mrt_dump_sce_contacts(struct mrt_sce_data *d)
+{
+  buffer *b = mrt_bgp_buffer();
+  mrt_init_message(b, MRT_SCE, d->subtype);
+  mrt_sce_header(b, d);
+  mrt_put_u32(b, d->count);
+
+  for (uint i = 0; i < d->count; i++)
+  {
+    const scheduled_contact_entry *e = d->sces[i];
+
+    mrt_put_u64(b, e->start_time);
+    mrt_put_u64(b, e->duration);
+    mrt_put_u32(b, e->asn1);
+    mrt_put_u32(b, e->gw1);
+    mrt_put_u32(b, e->asn2);
+    mrt_put_u32(b, e->gw2);
+  }
+
+  mrt_dump_message(b, config->mrtdump_file);
+}
+
+void
+mrt_dump_sce_route(struct mrt_sce_data *d)
+{
+  const net_addr *n = d->net;
+
+  if (!net_is_ip(n))
+    return;
+
+  buffer *b = mrt_bgp_buffer();
+  mrt_init_message(b, MRT_SCE, d->subtype);
+  mrt_sce_header(b, d);
+
+  /* Network Prefix, like in RIB entries of the table dump */
+  uint len = net_pxlen(n);
+
+  if (n->type == NET_IP4)
+  {
+    ip4_addr a = ip4_hton(net4_prefix(n));
+
+    mrt_put_u16(b, BGP_AFI_IPV4);
+    mrt_put_u8(b, len);
+    mrt_put_data(b, &a, BYTES(len));
+  }
+  else
+  {
+    ip6_addr a = ip6_hton(net6_prefix(n));
+
+    mrt_put_u16(b, BGP_AFI_IPV6);
+    mrt_put_u8(b, len);
+    mrt_put_data(b, &a, BYTES(len));
+  }
+
+  /* AS_PATH with 4-byte ASNs */
+  mrt_put_u16(b, d->path->length);
+  mrt_put_data(b, d->path->data, d->path->length);
+  mrt_dump_message(b, config->mrtdump_file);
+}
+
+
 /*
  *	MRT protocol glue
  */
@@ -109,6 +109,16 @@ struct mrt_bgp_data {
   u8 add_path;
 };
 
+struct mrt_sce_data {
+  uint local_as;			/* Own public ASN */
+  uint peer_as;				/* ASN of the BGP neighbor of the contacts */
+  uint subtype;				/* MRT_SCE_* */
+  uint count;				/* Number of contacts */
+  const scheduled_contact_entry **sces;	/* Contacts for MRT_SCE_CONTACT_* */
+  const net_addr *net;			/* Network for MRT_SCE_ROUTE_* */
+  const struct adata *path;		/* AS_PATH of the route for MRT_SCE_ROUTE_* */
+};
+
 
 #define MRT_HDR_LENGTH		12	/* MRT Timestamp + MRT Type + MRT Subtype + MRT Load Length */
 #define MRT_PEER_TYPE_32BIT_ASN	2	/* MRT Table Dump: Peer Index Table: Peer Type: Use 32bit ASN */
@@ -119,6 +129,7 @@ struct mrt_bgp_data {
 /* MRT Types */
 #define MRT_TABLE_DUMP_V2 	13
 #define MRT_BGP4MP		16
+#define MRT_SCE			64	/* Scheduled contacts, not assigned by IANA */
 
 /* MRT Table Dump v2 Subtypes */
 #define MRT_PEER_INDEX_TABLE		1
@@ -144,15 +155,28 @@ struct mrt_bgp_data {
 #define MRT_BGP4MP_MESSAGE_LOCAL_ADDPATH	10
 #define MRT_BGP4MP_MESSAGE_AS4_LOCAL_ADDPATH	11
 
+/* MRT SCE Subtypes */
+#define MRT_SCE_CONTACT_BEGIN		1
+#define MRT_SCE_CONTACT_END		2
+#define MRT_SCE_ROUTE_ADD		3
+#define MRT_SCE_ROUTE_WITHDRAW		4
+
+#define MRT_SCE_HDR_LENGTH	8	/* MRT SCE: Local AS + Peer AS */
+#define MRT_SCE_CONTACT_LENGTH	32	/* MRT SCE: Start + Duration + AS1 + Gateway 1 + AS2 + Gateway 2 */
+
 
 #ifdef CONFIG_MRT
 void mrt_dump_cmd(struct mrt_dump_data *d);
 void mrt_dump_bgp_message(struct mrt_bgp_data *d);
 void mrt_dump_bgp_state_change(struct mrt_bgp_data *d);
+void mrt_dump_sce_contacts(struct mrt_sce_data *d);
+void mrt_dump_sce_route(struct mrt_sce_data *d);
 void mrt_check_config(struct proto_config *C);
 #else
 static inline void mrt_dump_bgp_message(struct mrt_bgp_data *d UNUSED) { }
 static inline void mrt_dump_bgp_state_change(struct mrt_bgp_data *d UNUSED) { }
+static inline void mrt_dump_sce_contacts(struct mrt_sce_data *d UNUSED) { }
+static inline void mrt_dump_sce_route(struct mrt_sce_data *d UNUSED) { }
 #endif
 
 #endif	/* _BIRD_MRT_H_ */
@@ -11,6 +11,14 @@
  *
  * Run this protocol to measure route import and export times.
  * Generates a load of dummy routes and measures time to import.
+ *
+ * The SCE mode generates dummy routes with AS paths and a plan of scheduled
+ * contacts between the transit ASes of these paths, then measures the time
+ * the SCE extension needs to handle the begin and the end of the contacts.
+ *
+ * The replay mode imports the routes of an MRT table dump instead and runs
+ * the contacts recorded by "mrtdump { contacts }" of a BGP protocol again,
+ * so real contact sequences can be profiled without the peers.
  */
 
 #undef LOCAL_DEBUG
@@ -23,11 +31,18 @@
 #include "conf/conf.h"
 #include "filter/filter.h"
 #include "lib/string.h"
+#include "lib/unaligned.h"
+#include "proto/bgp/bgp.h"
+#include "proto/mrt/mrt.h"
 
 #include "perf.h"
 
 #include <stdlib.h>
 #include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define PLOG(msg, ...) log(L_INFO "Perf %s %s " msg, BIRD_VERSION, p->p.name, ##__VA_ARGS__)
 
@@ -203,6 +218,691 @@ perf_loop(void *data)
   ev_schedule(p->loop);
 }
 
+/*
+ * Synthetic topology of the SCE mode. Every path starts at its own upstream AS,
+ * crosses one to four transit ASes and ends at the origin AS of the network,
+ * which gives path lengths similar to the DFZ. Contacts are only scheduled between
+ * transit ASes, so the next hops of the derived routes stay the same.
+ */
+#define PERF_SCE_LOCAL_AS	64496
+#define PERF_SCE_UPSTREAM_AS	64497
+#define PERF_SCE_TRANSIT_AS	65536
+#define PERF_SCE_TRANSITS	256
+#define PERF_SCE_ORIGIN_AS	131072
+
+static inline u32
+perf_sce_transit(u32 prev)
+{
+  /* Any transit AS but the previous one */
+  uint t = prev ? (prev - PERF_SCE_TRANSIT_AS + 1 + random() % (PERF_SCE_TRANSITS - 1)) : random();
+  return PERF_SCE_TRANSIT_AS + t % PERF_SCE_TRANSITS;
+}
+
+static struct rta *
+perf_path_rta(struct perf_proto *p, struct rte_src *src, ip_addr gw, struct adata *ad)
+{
+  ea_list *ea = alloca(sizeof(ea_list) + sizeof(eattr));
+  *ea = (ea_list) { .flags = EALF_SORTED, .count = 1 };
+  ea->attrs[0] = (eattr) {
+    .id = EA_CODE(PROTOCOL_BGP, BA_AS_PATH),
+    .flags = BAF_TRANSITIVE,
+    .type = EAF_TYPE_AS_PATH,
+    .u.ptr = ad,
+  };
+
+  struct rta a0 = {
+    .src = src,
+    .source = RTS_PERF,
+    .scope = SCOPE_UNIVERSE,
+    .dest = RTD_UNICAST,
+    .nh.iface = p->ifa->iface,
+    .nh.gw = gw,
+    .nh.weight = 1,
+    .eattrs = ea,
+  };
+
+  return rta_lookup(&a0);
+}
+
+static struct rta *
+perf_sce_rta(struct perf_proto *p, struct rte_src *src, ip_addr gw, uint path, u32 origin)
+{
+  uint len = 3 + random() % 4;
+  struct adata *ad = alloca(sizeof(struct adata) + 2 + 4 * len);
+  ad->length = 2 + 4 * len;
+  ad->data[0] = AS_PATH_SEQUENCE;
+  ad->data[1] = len;
+
+  u32 asn = 0;
+  put_u32(ad->data + 2, PERF_SCE_UPSTREAM_AS + path);
+  for (uint i = 1; i < len - 1; i++)
+    put_u32(ad->data + 2 + 4 * i, asn = perf_sce_transit(asn));
+  put_u32(ad->data + 2 + 4 * (len - 1), origin);
+
+  return perf_path_rta(p, src, gw, ad);
+}
+
+static inline struct rte_src *
+perf_sce_src(struct perf_proto *p, uint i)
+{
+  uint path = i % p->paths;
+  return path ? rt_get_source(&p->p, path) : p->p.main_source;
+}
+
+static s64
+perf_sce_event(entry_data **eds, uint count, void (*hook)(entry_data **eds, uint count))
+{
+  struct timespec ts_begin, ts_end;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts_begin);
+
+  rte_update_batch_lock();
+  hook(eds, count);
+  rte_update_batch_unlock();
+  sce_scratch_flush();
+
+  clock_gettime(CLOCK_MONOTONIC, &ts_end);
+
+  return timediff(&ts_begin, &ts_end);
+}
+
+static void
+perf_loop_sce(void *data)
+{
+  struct proto *P = data;
+  struct perf_proto *p = data;
+
+  const uint N = 1U << p->exp;
+  const uint R = N * p->paths;
+  const uint C = p->contacts;
+
+  if (!p->run) {
+    ASSERT(p->data == NULL);
+    p->data = xmalloc(sizeof(struct perf_random_routes) * R);
+    p->stop = 1;
+  }
+
+  /* Every run of the same exponent generates the same table and plan */
+  srandom(p->exp);
+
+  ip_addr gw = random_gw(&p->ifa->prefix);
+
+  struct timespec ts_begin, ts_generated, ts_update, ts_contacts, ts_withdraw;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts_begin);
+
+  for (uint i=0; i<N; i++) {
+    net_addr_ip4 net = random_net_ip4();
+    u32 origin = PERF_SCE_ORIGIN_AS + i;
+
+    for (uint k=0; k<p->paths; k++) {
+      struct perf_random_routes *r = &p->data[i * p->paths + k];
+
+      *((net_addr_ip4 *) &(r->net)) = net;
+      r->a = perf_sce_rta(p, perf_sce_src(p, k), gw, k, origin);
+    }
+  }
+
+  scheduled_contact_entry *sce = xmalloc(sizeof(scheduled_contact_entry) * C);
+  entry_data *ed = xmalloc(sizeof(entry_data) * C);
+  struct sce_stats *stats = xmalloc(sizeof(struct sce_stats) * C);
+  memset(stats, 0, sizeof(struct sce_stats) * C);
+
+  for (uint j=0; j<C; j++) {
+    u32 asn1 = perf_sce_transit(0);
+
+    sce[j] = (scheduled_contact_entry) {
+      .start_time = j,
+      .duration = p->overlap,
+      .asn1 = asn1,
+      .asn2 = perf_sce_transit(asn1),
+    };
+
+    ed[j] = (entry_data) {
+      .sce = &sce[j],
+      .ch = P->main_channel,
+      .proto = p->sce_proto,
+      .stats = &stats[j],
+    };
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &ts_generated);
+
+  for (uint i=0; i<R; i++) {
+    rte *e = rte_get_temp(p->data[i].a);
+    e->pflags = 0;
+
+    rte_update2(P->main_channel, &(p->data[i].net), e, perf_sce_src(p, i));
+  }
+
+  /* The index of the table is built on first use, keep it out of the contacts */
+  sce_index_get(P->main_channel->table);
+
+  clock_gettime(CLOCK_MONOTONIC, &ts_update);
+
+  /* Contact j begins at time j and ends at time j + overlap */
+  s64 begintime = 0, endtime = 0;
+
+  for (uint j=0; j<C + p->overlap; j++) {
+    if (j >= p->overlap) {
+      entry_data *e = &ed[j - p->overlap];
+      endtime += perf_sce_event(&e, 1, contact_end);
+    }
+
+    if (j < C) {
+      entry_data *e = &ed[j];
+      begintime += perf_sce_event(&e, 1, contact_begin);
+    }
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &ts_contacts);
+
+  if (!p->keep)
+    for (uint i=0; i<R; i++)
+      rte_update2(P->main_channel, &(p->data[i].net), NULL, perf_sce_src(p, i));
+
+  clock_gettime(CLOCK_MONOTONIC, &ts_withdraw);
+
+  uint added = 0, withdrawn = 0;
+  for (uint j=0; j<C; j++) {
+    added += stats[j].added;
+    withdrawn += stats[j].withdrawn;
+  }
+
+  xfree(sce);
+  xfree(ed);
+  xfree(stats);
+
+  s64 gentime = timediff(&ts_begin, &ts_generated);
+  s64 updatetime = timediff(&ts_generated, &ts_update);
+  s64 contacttime = timediff(&ts_update, &ts_contacts);
+  s64 withdrawtime = timediff(&ts_contacts, &ts_withdraw);
+
+  if (contacttime NS >= p->threshold_min)
+    PLOG("exp=%u contacts=%u times: gen=%ld update=%ld begin=%ld end=%ld withdraw=%ld routes: added=%u withdrawn=%u",
+	p->exp, C, gentime, updatetime, begintime, endtime, withdrawtime, added, withdrawn);
+
+  if (contacttime NS < p->threshold_max)
+    p->stop = 0;
+
+  if ((contacttime NS < p->threshold_min) || (++p->run == p->repeat)) {
+    xfree(p->data);
+    p->data = NULL;
+
+    if (p->stop || (p->exp == p->to)) {
+      PLOG("done with exp=%u", p->exp);
+      return;
+    }
+
+    p->run = 0;
+    p->exp++;
+  }
+
+  rt_schedule_prune(P->main_channel->table);
+  ev_schedule(p->loop);
+}
+
+/*
+ * Replay mode. The routes of the table dump keep their AS paths only, they get
+ * the gateway of the other modes and a source per RIB entry, so all routes of
+ * a network are kept. The contacts run in the recorded batches, the route
+ * changes of every batch are compared to the recorded ones.
+ */
+struct perf_mrt_file {
+  const char *name;
+  byte *data;
+  size_t size;
+};
+
+struct perf_replay_event {
+  uint type;				/* MRT_SCE_CONTACT_BEGIN or MRT_SCE_CONTACT_END, 0 for none */
+  uint contacts;			/* Number of contacts of the batch */
+  uint added, withdrawn;		/* Route changes of the replay */
+  uint rec_added, rec_withdrawn;	/* Route changes in the recording */
+  s64 time;
+};
+
+static int
+perf_mrt_open(struct perf_proto *p, struct perf_mrt_file *f, const char *name)
+{
+  struct stat st;
+  int fd = open(name, O_RDONLY);
+
+  *f = (struct perf_mrt_file) { .name = name };
+
+  if ((fd < 0) || (fstat(fd, &st) < 0))
+  {
+    log(L_ERR "%s: Cannot open %s: %m", p->p.name, name);
+    if (fd >= 0)
+      close(fd);
+    return 0;
+  }
+
+  f->size = st.st_size;
+  f->data = f->size ? mmap(NULL, f->size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+  close(fd);
+
+  if (f->data == MAP_FAILED)
+  {
+    log(L_ERR "%s: Cannot map %s: %m", p->p.name, name);
+    f->data = NULL;
+    return 0;
+  }
+
+  return 1;
+}
+
+static void
+perf_mrt_close(struct perf_mrt_file *f)
+{
+  if (f->data)
+    munmap(f->data, f->size);
+
+  f->data = NULL;
+}
+
+/* Returns the body of the MRT record at @pos and moves @pos behind it, NULL if it is truncated */
+static const byte *
+perf_mrt_next(const byte **pos, const byte *end, uint *type, uint *subtype, uint *len)
+{
+  const byte *hdr = *pos;
+
+  if ((size_t) (end - hdr) < MRT_HDR_LENGTH)
+    return NULL;
+
+  *type = get_u16(hdr + 4);
+  *subtype = get_u16(hdr + 6);
+  *len = get_u32(hdr + 8);
+
+  if ((size_t) (end - hdr) - MRT_HDR_LENGTH < *len)
+    return NULL;
+
+  *pos = hdr + MRT_HDR_LENGTH + *len;
+  return hdr + MRT_HDR_LENGTH;
+}
+
+static const byte *
+perf_mrt_prefix(const byte *pos, const byte *end, uint afi, net_addr *n)
+{
+  if (pos >= end)
+    return NULL;
+
+  uint len = *pos++;
+
+  if (afi == BGP_AFI_IPV4)
+  {
+    ip4_addr a = IP4_NONE;
+
+    if ((len > IP4_MAX_PREFIX_LENGTH) || ((size_t) (end - pos) < BYTES(len)))
+      return NULL;
+
+    memcpy(&a, pos, BYTES(len));
+    net_fill_ip4(n, ip4_and(ip4_ntoh(a), ip4_mkmask(len)), len);
+  }
+  else
+  {
+    ip6_addr a = IP6_NONE;
+
+    if ((len > IP6_MAX_PREFIX_LENGTH) || ((size_t) (end - pos) < BYTES(len)))
+      return NULL;
+
+    memcpy(&a, pos, BYTES(len));
+    net_fill_ip6(n, ip6_and(ip6_ntoh(a), ip6_mkmask(len)), len);
+  }
+
+  return pos + BYTES(len);
+}
+
+/* Finds the AS_PATH in BGP path attributes, returns -1 if they are malformed */
+static int
+perf_mrt_as_path(const byte *pos, const byte *end, const byte **path, uint *len)
+{
+  while (pos < end)
+  {
+    if (end - pos < 3)
+      return -1;
+
+    uint flags = pos[0], code = pos[1];
+    uint hdr = (flags & BAF_EXT_LEN) ? 4 : 3;
+
+    if ((uint) (end - pos) < hdr)
+      return -1;
+
+    uint alen = (flags & BAF_EXT_LEN) ? get_u16(pos + 2) : pos[2];
+    pos += hdr;
+
+    if ((uint) (end - pos) < alen)
+      return -1;
+
+    if (code == BA_AS_PATH)
+    {
+      *path = pos;
+      *len = alen;
+      return 1;
+    }
+
+    pos += alen;
+  }
+
+  return 0;
+}
+
+/*
+ * Imports (or withdraws) the routes of one RIB record of the table dump.
+ * Records of other address families than the channel are skipped.
+ * Returns the number of routes or -1 if the record is malformed.
+ */
+static int
+perf_replay_rib(struct perf_proto *p, const byte *pos, const byte *end, uint subtype, ip_addr gw, int withdraw)
+{
+  struct channel *c = p->p.main_channel;
+  uint afi = (c->net_type == NET_IP4) ? BGP_AFI_IPV4 : BGP_AFI_IPV6;
+  int add_path;
+
+  switch (subtype)
+  {
+  case MRT_RIB_IPV4_UNICAST:
+  case MRT_RIB_IPV6_UNICAST:
+    add_path = 0;
+    break;
+
+  case MRT_RIB_IPV4_UNICAST_ADDPATH:
+  case MRT_RIB_IPV6_UNICAST_ADDPATH:
+    add_path = 1;
+    break;
+
+  default:
+    return 0;
+  }
+
+  int ipv4 = (subtype == MRT_RIB_IPV4_UNICAST) || (subtype == MRT_RIB_IPV4_UNICAST_ADDPATH);
+  if (ipv4 != (afi == BGP_AFI_IPV4))
+    return 0;
+
+  /* Sequence Number and Network Prefix */
+  net_addr n;
+  if ((end - pos < 4) || !(pos = perf_mrt_prefix(pos + 4, end, afi, &n)) || (end - pos < 2))
+    return -1;
+
+  uint count = get_u16(pos);
+  pos += 2;
+
+  /* Peer Index, Originated Time, Path Identifier and Attribute Length */
+  uint hdr = add_path ? 12 : 8;
+  int routes = 0;
+
+  for (uint i = 0; i < count; i++)
+  {
+    if ((uint) (end - pos) < hdr)
+      return -1;
+
+    uint len = get_u16(pos + hdr - 2);
+    pos += hdr;
+
+    if ((uint) (end - pos) < len)
+      return -1;
+
+    const byte *path;
+    uint path_len;
+    int found = perf_mrt_as_path(pos, pos + len, &path, &path_len);
+    pos += len;
+
+    if (found < 0)
+      return -1;
+
+    /* Table dumps always use 4-byte ASNs */
+    if (!found || !as_path_valid((byte *) path, path_len, 4, 1, 1, NULL, 0))
+      continue;
+
+    struct rte_src *src = i ? rt_get_source(&p->p, i) : p->p.main_source;
+    routes++;
+
+    if (withdraw)
+    {
+      rte_update2(c, &n, NULL, src);
+      continue;
+    }
+
+    struct adata *ad = alloca(sizeof(struct adata) + path_len);
+    ad->length = path_len;
+    memcpy(ad->data, path, path_len);
+
+    rte *e = rte_get_temp(perf_path_rta(p, src, gw, ad));
+    e->pflags = 0;
+
+    rte_update2(c, &n, e, src);
+  }
+
+  return routes;
+}
+
+static int
+perf_replay_table(struct perf_proto *p, struct perf_mrt_file *f, ip_addr gw, int withdraw)
+{
+  const byte *pos = f->data, *end = f->data + f->size;
+  int routes = 0;
+
+  while (pos < end)
+  {
+    uint type, subtype, len;
+    const byte *body = perf_mrt_next(&pos, end, &type, &subtype, &len);
+    int num = 0;
+
+    if (body && (type == MRT_TABLE_DUMP_V2))
+      num = perf_replay_rib(p, body, body + len, subtype, gw, withdraw);
+
+    if (!body || (num < 0))
+    {
+      log(L_ERR "%s: Malformed table dump %s", p->p.name, f->name);
+      return -1;
+    }
+
+    routes += num;
+  }
+
+  return routes;
+}
+
+/* Runs the batch of contacts of one recorded MRT_SCE_CONTACT_* record */
+static int
+perf_replay_contacts(struct perf_proto *p, const byte *pos, const byte *end, uint subtype, struct perf_replay_event *ev)
+{
+  if ((size_t) (end - pos) < MRT_SCE_HDR_LENGTH + 4)
+    return 0;
+
+  u32 local_as = get_u32(pos);
+  uint count = get_u32(pos + MRT_SCE_HDR_LENGTH);
+  pos += MRT_SCE_HDR_LENGTH + 4;
+
+  if (!count || ((size_t) (end - pos) / MRT_SCE_CONTACT_LENGTH < count))
+    return 0;
+
+  scheduled_contact_entry *sce = xmalloc(sizeof(scheduled_contact_entry) * count);
+  entry_data *ed = xmalloc(sizeof(entry_data) * count);
+  entry_data **eds = xmalloc(sizeof(entry_data *) * count);
+  struct sce_stats *stats = xmalloc(sizeof(struct sce_stats) * count);
+  memset(stats, 0, sizeof(struct sce_stats) * count);
+
+  /* The routes are computed for the AS that recorded the contacts */
+  p->sce_proto->public_as = local_as;
+
+  for (uint j=0; j<count; j++, pos += MRT_SCE_CONTACT_LENGTH) {
+    sce[j] = (scheduled_contact_entry) {
+      .start_time = get_u64(pos),
+      .duration = get_u64(pos + 8),
+      .asn1 = get_u32(pos + 16),
+      .gw1 = get_u32(pos + 20),
+      .asn2 = get_u32(pos + 24),
+      .gw2 = get_u32(pos + 28),
+    };
+
+    ed[j] = (entry_data) {
+      .sce = &sce[j],
+      .ch = p->p.main_channel,
+      .proto = p->sce_proto,
+      .stats = &stats[j],
+    };
+
+    eds[j] = &ed[j];
+  }
+
+  *ev = (struct perf_replay_event) { .type = subtype, .contacts = count };
+  ev->time = perf_sce_event(eds, count, (subtype == MRT_SCE_CONTACT_BEGIN) ? contact_begin : contact_end);
+
+  for (uint j=0; j<count; j++) {
+    ev->added += stats[j].added;
+    ev->withdrawn += stats[j].withdrawn;
+  }
+
+  xfree(sce);
+  xfree(ed);
+  xfree(eds);
+  xfree(stats);
+
+  return 1;
+}
+
+/* Logs a replayed batch, returns 1 if its route changes differ from the recording */
+static int
+perf_replay_log(struct perf_proto *p, uint num, struct perf_replay_event *ev)
+{
+  PLOG("replay event=%u %s contacts=%u time=%ld routes: added=%u withdrawn=%u recorded: added=%u withdrawn=%u",
+      num, (ev->type == MRT_SCE_CONTACT_BEGIN) ? "begin" : "end", ev->contacts, ev->time,
+      ev->added, ev->withdrawn, ev->rec_added, ev->rec_withdrawn);
+
+  return (ev->added != ev->rec_added) || (ev->withdrawn != ev->rec_withdrawn);
+}
+
+/* Removes the routes of the contacts, that were still open at the end of the recording */
+static void
+perf_replay_flush(struct channel *c)
+{
+  FIB_WALK(&c->table->fib, net, n)
+  {
+    rte *e, *next;
+    for (e = n->routes; e; e = next)
+    {
+      next = e->next;
+
+      if (rte_is_local(e) && (e->sender == c))
+      {
+	rte_remove_local(e);
+	next = n->routes;
+      }
+    }
+  }
+  FIB_WALK_END;
+}
+
+static void
+perf_loop_replay(void *data)
+{
+  struct proto *P = data;
+  struct perf_proto *p = data;
+
+  struct perf_mrt_file rib, rec;
+
+  if (!perf_mrt_open(p, &rib, p->table_dump))
+    return;
+
+  if (!perf_mrt_open(p, &rec, p->recording))
+  {
+    perf_mrt_close(&rib);
+    return;
+  }
+
+  ip_addr gw = random_gw(&p->ifa->prefix);
+
+  struct timespec ts_begin, ts_update, ts_contacts, ts_withdraw;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts_begin);
+
+  int routes = perf_replay_table(p, &rib, gw, 0);
+
+  /* The index of the table is built on first use, keep it out of the contacts */
+  sce_index_get(P->main_channel->table);
+
+  clock_gettime(CLOCK_MONOTONIC, &ts_update);
+
+  /* The route changes of a batch follow its record */
+  struct perf_replay_event ev = {};
+  const byte *pos = rec.data, *end = rec.data + rec.size;
+  uint events = 0, differ = 0;
+  s64 begintime = 0, endtime = 0;
+
+  while ((routes >= 0) && (pos < end))
+  {
+    uint type, subtype, len;
+    const byte *body = perf_mrt_next(&pos, end, &type, &subtype, &len);
+
+    if (!body)
+    {
+      log(L_ERR "%s: Truncated recording %s", p->p.name, rec.name);
+      break;
+    }
+
+    if (type != MRT_SCE)
+      continue;
+
+    switch (subtype)
+    {
+    case MRT_SCE_CONTACT_BEGIN:
+    case MRT_SCE_CONTACT_END:
+      if (ev.type)
+	differ += perf_replay_log(p, events, &ev);
+
+      if (!perf_replay_contacts(p, body, body + len, subtype, &ev))
+      {
+	log(L_ERR "%s: Malformed contacts in recording %s", p->p.name, rec.name);
+	ev.type = 0;
+	continue;
+      }
+
+      events++;
+      if (subtype == MRT_SCE_CONTACT_BEGIN)
+	begintime += ev.time;
+      else
+	endtime += ev.time;
+      break;
+
+    case MRT_SCE_ROUTE_ADD:
+      ev.rec_added++;
+      break;
+
+    case MRT_SCE_ROUTE_WITHDRAW:
+      ev.rec_withdrawn++;
+      break;
+    }
+  }
+
+  if (ev.type)
+    differ += perf_replay_log(p, events, &ev);
+
+  clock_gettime(CLOCK_MONOTONIC, &ts_contacts);
+
+  if (!p->keep && (routes > 0))
+  {
+    perf_replay_table(p, &rib, gw, 1);
+    perf_replay_flush(P->main_channel);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &ts_withdraw);
+
+  perf_mrt_close(&rib);
+  perf_mrt_close(&rec);
+
+  /* Neighbors found for the gateways of the contacts belong to no real protocol */
+  neigh_prune();
+
+  s64 updatetime = timediff(&ts_begin, &ts_update);
+  s64 withdrawtime = timediff(&ts_contacts, &ts_withdraw);
+
+  PLOG("replay done routes=%d events=%u differ=%u times: update=%ld begin=%ld end=%ld withdraw=%ld",
+      routes, events, differ, updatetime, begintime, endtime, withdrawtime);
+
+  rt_schedule_prune(P->main_channel->table);
+}
+
 static void
 perf_rt_notify(struct proto *P, struct channel *c UNUSED, struct network *net UNUSED, struct rte *new UNUSED, struct rte *old UNUSED)
 {
@@ -251,11 +951,12 @@ perf_init(struct proto_config *CF)
   P->main_channel = proto_add_channel(P, proto_cf_main_channel(CF));
 
   struct perf_proto *p = (struct perf_proto *) P;
-
-  p->loop = ev_new_init(P->pool, perf_loop, p);
-
   struct perf_config *cf = (struct perf_config *) CF;
 
+  p->loop = ev_new_init(P->pool,
+      (cf->mode == PERF_MODE_SCE) ? perf_loop_sce :
+      (cf->mode == PERF_MODE_REPLAY) ? perf_loop_replay : perf_loop, p);
+
   p->threshold_min = cf->threshold_min;
   p->threshold_max = cf->threshold_max;
   p->from = cf->from;
@@ -264,11 +965,23 @@ perf_init(struct proto_config *CF)
   p->keep = cf->keep;
   p->mode = cf->mode;
   p->attrs_per_rte = cf->attrs_per_rte;
+  p->contacts = cf->contacts;
+  p->overlap = cf->overlap;
+  p->paths = cf->paths;
+  p->table_dump = cf->table_dump;
+  p->recording = cf->recording;
 
   switch (p->mode) {
     case PERF_MODE_IMPORT:
       P->ifa_notify = perf_ifa_notify;
       break;
+    case PERF_MODE_SCE:
+    case PERF_MODE_REPLAY:
+      /* The SCE extension only needs the local ASN of the BGP instance */
+      p->sce_proto = mb_allocz(P->pool, sizeof(struct bgp_proto));
+      p->sce_proto->public_as = PERF_SCE_LOCAL_AS;
+      P->ifa_notify = perf_ifa_notify;
+      break;
     case PERF_MODE_EXPORT:
       P->rt_notify = perf_rt_notify;
       P->feed_begin = perf_feed_begin;
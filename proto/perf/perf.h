@@ -12,6 +12,8 @@
 enum perf_mode {
   PERF_MODE_IMPORT,
   PERF_MODE_EXPORT,
+  PERF_MODE_SCE,
+  PERF_MODE_REPLAY,
 };
 
 struct perf_config {
@@ -23,6 +25,11 @@ struct perf_config {
   uint repeat;
   uint keep;
   uint attrs_per_rte;
+  uint contacts;
+  uint overlap;
+  uint paths;
+  const char *table_dump;
+  const char *recording;
   enum perf_mode mode;
 };
 
@@ -42,6 +49,12 @@ struct perf_proto {
   uint stop;
   uint keep;
   uint attrs_per_rte;
+  uint contacts;
+  uint overlap;
+  uint paths;
+  const char *table_dump;
+  const char *recording;
+  struct bgp_proto *sce_proto;
   enum perf_mode mode;
 };
 